@@ -0,0 +1,281 @@
+//
+//  AllocationTest.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 31..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+//  Checks that the per-sample path of the R-type roots never allocates after the warm-up.
+//  The allocation functions of the C library are replaced, so the memory of armadillo(which doesn't use operator new) is counted too.
+//  It's a standalone program, build it with the sources of the library:
+//
+//  c++ -std=c++14 -O2 -I../WDF ../WDF/*.cpp AllocationTest.cpp -larmadillo -o AllocationTest
+//
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "WDFTree.hpp"
+#include "WDFDiode.hpp"
+#include "WDFTube.hpp"
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#endif
+
+//============================================================
+// the allocation functions which count the allocations while enabled
+// operator new of the standard library and armadillo(memory::acquire) allocate by them
+//============================================================
+static std::atomic<bool> bCounting(false);
+static std::atomic<unsigned long> nAllocations(0);
+
+static void Count()
+{
+	if(bCounting.load(std::memory_order_relaxed))
+		nAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if defined(__APPLE__)
+// the functions of every malloc zone are replaced(the default zone forwards to the nano zone)
+static const unsigned int maxZones = 16;
+static malloc_zone_t* zones[maxZones];
+static malloc_zone_t originals[maxZones];
+static unsigned int nZones = 0;
+
+static const malloc_zone_t& Original(malloc_zone_t* zone)
+{
+	unsigned int i = 0;
+	while(i < nZones - 1 && zones[i] != zone)
+		i++;
+	return originals[i];
+}
+
+static void* ZoneMalloc(malloc_zone_t* zone, size_t size) { Count(); return Original(zone).malloc(zone, size); }
+static void* ZoneCalloc(malloc_zone_t* zone, size_t n, size_t size) { Count(); return Original(zone).calloc(zone, n, size); }
+static void* ZoneValloc(malloc_zone_t* zone, size_t size) { Count(); return Original(zone).valloc(zone, size); }
+static void* ZoneRealloc(malloc_zone_t* zone, void* p, size_t size) { Count(); return Original(zone).realloc(zone, p, size); }
+static void* ZoneMemalign(malloc_zone_t* zone, size_t alignment, size_t size) { Count(); return Original(zone).memalign(zone, alignment, size); }
+
+static void InstallCounters()
+{
+	vm_address_t* addresses = NULL;
+	unsigned int count = 0;
+	if(malloc_get_all_zones(mach_task_self(), NULL, &addresses, &count) != KERN_SUCCESS)
+		return;
+
+	for(unsigned int i=0; i<count && nZones<maxZones; i++)
+	{
+		malloc_zone_t* zone = (malloc_zone_t*)addresses[i];
+		zones[nZones] = zone;
+		originals[nZones++] = *zone;
+
+		// the zones are read-only since macOS 10.7
+		vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+		zone->malloc = ZoneMalloc;
+		zone->calloc = ZoneCalloc;
+		zone->valloc = ZoneValloc;
+		zone->realloc = ZoneRealloc;
+		if(zone->version >= 5 && zone->memalign)
+			zone->memalign = ZoneMemalign;
+		vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+	}
+}
+#else
+// the definitions in the program replace the ones of the C library(glibc)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+extern "C" void* __libc_memalign(size_t alignment, size_t size);
+
+extern "C" void* malloc(size_t size) { Count(); return __libc_malloc(size); }
+extern "C" void* calloc(size_t n, size_t size) { Count(); return __libc_calloc(n, size); }
+extern "C" void* realloc(void* p, size_t size) { Count(); return __libc_realloc(p, size); }
+extern "C" void* memalign(size_t alignment, size_t size) { Count(); return __libc_memalign(alignment, size); }
+extern "C" void* aligned_alloc(size_t alignment, size_t size) { Count(); return __libc_memalign(alignment, size); }
+extern "C" int posix_memalign(void** p, size_t alignment, size_t size)
+{
+	Count();
+	*p = __libc_memalign(alignment, size);
+	return *p ? 0 : ENOMEM;
+}
+
+static void InstallCounters()
+{
+	
+}
+#endif
+
+//============================================================
+// the circuit: Vs(2.2k) -- C(10n) || D, the root solved by MNA
+//============================================================
+static const double T = 1.0 / 48000.0;
+
+static WDFTree* CreateClipper(WDFRTypeRootLeaf* d)
+{
+	WDFTree* tree = new WDFTree(T, 1, 1000);
+	WDFVoltageSource* vs = new WDFVoltageSource(0, 2200, "Vs");
+	WDFCapacitor* c = new WDFCapacitor(10e-9, T, "C");
+	WDFRTypeAdaptorNL* root = new WDFRTypeAdaptorNL(1, 2, 1, "Root");
+	root->ConnectNL(3, -1, d->vecPorts[RFP]);
+	root->Connect(3, -1, vs);
+	root->Connect(3, -1, c);
+	root->UpdateMatrices();
+
+	tree->AddObject(vs);
+	tree->AddObject(c);
+	tree->AddObject(d);
+	tree->AddObject(root);
+	tree->SetInput(vs);
+	tree->SetRoot(root);
+	tree->SetOutput(c);
+	return tree;
+}
+
+//============================================================
+// a diode pair which implements only the vec versions, so the root calls them through the default wrappers of WDFRTypeRootLeaf
+//============================================================
+class VecDiodePair : public WDFRTypeRootLeaf
+{
+public:
+	VecDiodePair() : WDFRTypeRootLeaf(1, "D") {}
+
+	virtual vec Nonlinear(vec Vc)
+	{
+		vec Ic(1);
+		Ic(0) = 2.0 * Is * sinh(Vc(0) / nVt);
+		return Ic;
+	}
+
+	virtual mat DiffNonlinear(vec Vc)
+	{
+		mat J(1, 1);
+		J(0, 0) = 2.0 * Is / nVt * cosh(Vc(0) / nVt);
+		return J;
+	}
+
+private:
+	const double Is = 2.52e-9;
+	const double nVt = 1.752 * 25.85e-3;
+};
+
+//============================================================
+// the circuit: a pentode stage, the root has 3 nonlinear ports & 4 subtrees(its matrices don't fit in the local memory of armadillo)
+// Vs(10k) at the grid 1, B+(250V, 2k) at the plate, the screen(250V, 1k) at the grid 2, and Rk(250) || Ck(22u) at the cathode
+//============================================================
+static WDFTree* CreatePentodeStage()
+{
+	WDFTree* tree = new WDFTree(T, 1, 1000);
+	WDFRTypeNKPentode* pentode = new WDFRTypeNKPentode(P_6L6GC, MODE_PENTODE, "V1");
+	WDFVoltageSource* vs = new WDFVoltageSource(0, 10000, "Vs");
+	WDFVoltageSource* vp = new WDFVoltageSource(250, 2000, "B+");
+	WDFVoltageSource* vg2 = new WDFVoltageSource(250, 1000, "Vg2");
+	WDFResistor* rk = new WDFResistor(250, "Rk");
+	WDFCapacitor* ck = new WDFCapacitor(22e-6, T, "Ck");
+	WDFParallel* cathode = new WDFParallel(rk, ck, "K");
+
+	// the nodes: the ports(0-6), then the plate(7), the grid 1(8), the grid 2(9) & the cathode(10)
+	WDFRTypeAdaptorNL* root = new WDFRTypeAdaptorNL(3, 4, 4, "Root");
+	root->ConnectNL(7, 10, pentode->vecPorts[0]);		// Vpk
+	root->ConnectNL(8, 10, pentode->vecPorts[1]);		// Vg1k
+	root->ConnectNL(9, 10, pentode->vecPorts[2]);		// Vg2k
+	root->Connect(8, -1, vs);
+	root->Connect(7, -1, vp);
+	root->Connect(9, -1, vg2);
+	root->Connect(10, -1, cathode);
+	root->UpdateMatrices();
+
+	WDFObject* objects[] = { pentode, vs, vp, vg2, rk, ck, cathode, root };
+	for(unsigned int i=0; i<sizeof(objects)/sizeof(objects[0]); i++)
+		tree->AddObject(objects[i]);
+	tree->SetInput(vs);
+	tree->SetRoot(root);
+	tree->SetOutput(rk);
+	return tree;
+}
+
+/**
+ Process the tree after the warm-up, then count the allocations
+
+ @param name the name of the case
+ @param tree the tree to be processed
+ @param nSamples the number of samples counted
+ @return true if nothing is allocated
+ */
+static bool Check(const char* name, WDFTree* tree, unsigned int nSamples)
+{
+	const unsigned int blockSize = 64;
+	float block[blockSize];
+	unsigned long n = 0;
+
+	// the warm-up sizes the workspaces & the history of the predictors
+	for(unsigned int i=0; i<4800; i++, n++)
+		tree->Process((float)(3.0 * sin(2.0 * M_PI * 220.0 * n * T)));
+
+	nAllocations = 0;
+	bCounting = true;
+	for(unsigned int i=0; i<nSamples; i+=blockSize)
+	{
+		for(unsigned int k=0; k<blockSize; k++, n++)
+			block[k] = (float)(3.0 * sin(2.0 * M_PI * 220.0 * n * T));
+		tree->Process(block, block, blockSize);
+	}
+	bCounting = false;
+
+	const unsigned long count = nAllocations;
+	printf("%-16s %lu allocations in %u samples\n", name, count, nSamples);
+	return count == 0;
+}
+
+int main()
+{
+	InstallCounters();
+
+	// the counters must see the allocations of armadillo
+	bCounting = true;
+	mat probe = zeros<mat>(64, 64);
+	bCounting = false;
+	if(nAllocations == 0)
+	{
+		printf("the allocations aren't counted\nFAILED\n");
+		return 1;
+	}
+
+	const unsigned int nSamples = 48000;
+	bool bPassed = true;
+
+	const NonlinearSolverType solvers[] = { NonlinearSolverType::NEWTON, NonlinearSolverType::CHORD, NonlinearSolverType::DAMPED_NEWTON, NonlinearSolverType::BROYDEN, NonlinearSolverType::FIXED_POINT, NonlinearSolverType::TABULATED };
+	const char* names[] = { "newton", "chord", "damped newton", "broyden", "fixed point", "tabulated" };
+	for(unsigned int i=0; i<sizeof(solvers)/sizeof(solvers[0]); i++)
+	{
+		WDFTree* tree = CreateClipper(new WDFRTypeDiode(2.52e-9, 25.85e-3, 1.752, "D"));
+		tree->SetNonlinearSolver(solvers[i]);
+		bPassed = Check(names[i], tree, nSamples) && bPassed;
+		delete tree;
+	}
+
+	WDFTree* tree = CreateClipper(new WDFRTypeDiode(2.52e-9, 25.85e-3, 1.752, "D"));
+	tree->SetQuality(WDFQuality::LINEARIZED);
+	bPassed = Check("linearized", tree, nSamples) && bPassed;
+	delete tree;
+
+	tree = CreateClipper(new VecDiodePair());
+	bPassed = Check("vec leaf", tree, nSamples) && bPassed;
+	delete tree;
+
+	const NonlinearSolverType pentodeSolvers[] = { NonlinearSolverType::NEWTON, NonlinearSolverType::DAMPED_NEWTON, NonlinearSolverType::BROYDEN };
+	const char* pentodeNames[] = { "pentode newton", "pentode damped", "pentode broyden" };
+	for(unsigned int i=0; i<sizeof(pentodeSolvers)/sizeof(pentodeSolvers[0]); i++)
+	{
+		tree = CreatePentodeStage();
+		tree->SetNonlinearSolver(pentodeSolvers[i]);
+		bPassed = Check(pentodeNames[i], tree, nSamples) && bPassed;
+		delete tree;
+	}
+
+	printf(bPassed ? "PASSED\n" : "FAILED\n");
+	return bPassed ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+//
+//  DenormalBenchmark.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 31..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+//  Measures the decay tail of an RC circuit after an impulse with the denormal handling of WDFTree,
+//  and checks that the stored waves never become denormal while it is enabled.
+//  It's a standalone program, build it with the sources of the library(-ffast-math sets FTZ/DAZ for the whole program):
+//
+//  c++ -std=c++14 -O2 -I../WDF ../WDF/*.cpp DenormalBenchmark.cpp -larmadillo -o DenormalBenchmark
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include "WDFTree.hpp"
+
+//============================================================
+// the circuit: Vs(1k) -- C(1u) || RL(10k), the time constant is about 0.9 ms
+//============================================================
+static const double T = 1.0 / 48000.0;
+
+static WDFTree* CreateRC(WDFCapacitor** c)
+{
+	WDFTree* tree = new WDFTree(T, 1, 1000);
+	WDFVoltageSource* vs = new WDFVoltageSource(0, 1000, "Vs");
+	*c = new WDFCapacitor(1e-6, T, "C");
+	WDFResistor* rl = new WDFResistor(10000, "RL");
+	WDFRTypeAdaptor* root = new WDFRTypeAdaptor(3, 3, 4, "Root");
+	root->Connect(3, -1, vs);
+	root->Connect(3, -1, *c);
+	root->Connect(3, -1, rl);
+	root->UpdateScatteringMatrix();
+
+	tree->AddObject(vs);
+	tree->AddObject(*c);
+	tree->AddObject(rl);
+	tree->AddObject(root);
+	tree->SetInput(vs);
+	tree->SetRoot(root);
+	tree->SetOutput(*c);
+	return tree;
+}
+
+//============================================================
+// the denormal handling
+//============================================================
+enum class Mode
+{
+	NONE,
+	ANTI_DENORMAL,
+	FTZ_DAZ
+};
+
+/**
+ Process an impulse and the silence after it by blocks, then print the timing
+
+ @param name the name of the case
+ @param mode the denormal handling
+ @return the number of blocks after which the stored wave of the capacitor is denormal
+ */
+static unsigned int Run(const char* name, Mode mode)
+{
+	WDFCapacitor* c;
+	WDFTree* tree = CreateRC(&c);
+	if(mode == Mode::ANTI_DENORMAL)
+		tree->SetAntiDenormal(1e-18);
+	tree->SetDenormalMode(mode == Mode::FTZ_DAZ);
+
+	// the wave becomes denormal after about 0.65 s, and the rounding keeps it there
+	const unsigned int blockSize = 64;
+	const unsigned int nBlocks = 48000 * 2 / blockSize;
+	float block[blockSize];
+	double total = 0.0, worst = 0.0;
+	unsigned int nDenormalBlocks = 0;
+	for(unsigned int i=0; i<nBlocks; i++)
+	{
+		for(unsigned int k=0; k<blockSize; k++)
+			block[k] = (i == 0 && k == 0) ? 1.0f : 0.0f;
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		tree->Process(block, block, blockSize);
+		const double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		total += elapsed;
+		if(elapsed > worst)
+			worst = elapsed;
+		if(std::fpclassify(c->vecPorts[RFP]->b) == FP_SUBNORMAL)
+			nDenormalBlocks++;
+	}
+
+	printf("%-14s total %8.1f us, worst block %6.2f us, average block %5.2f us, %u blocks end denormal\n", name, total, worst, total / nBlocks, nDenormalBlocks);
+	delete tree;
+	return nDenormalBlocks;
+}
+
+int main()
+{
+	Run("none", Mode::NONE);
+	const unsigned int nAntiDenormal = Run("anti-denormal", Mode::ANTI_DENORMAL);
+	const unsigned int nFlushed = Run("ftz/daz", Mode::FTZ_DAZ);
+
+	// the timing depends on the machine, but the states must never be denormal
+	const bool bPassed = (nAntiDenormal == 0 && nFlushed == 0);
+	printf(bPassed ? "PASSED\n" : "FAILED\n");
+	return bPassed ? 0 : 1;
+}
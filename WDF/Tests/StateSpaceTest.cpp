@@ -0,0 +1,137 @@
+//
+//  StateSpaceTest.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 31..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+//  Checks that the state-space engine follows the wave engine on a linear tree, also while the parameters change.
+//  It's a standalone program, build it with the sources of the library:
+//
+//  c++ -std=c++14 -O2 -I../WDF ../WDF/*.cpp StateSpaceTest.cpp -larmadillo -o StateSpaceTest
+//
+
+#include <cmath>
+#include <cstdio>
+#include "WDFTree.hpp"
+
+//============================================================
+// the circuit: (Vs(1k) + L(10m)) + (C2(22n) || R2(4.7k) || Vb(10k, 0.5V)), then C1(100n) || RT(100k) at the root
+//============================================================
+static const double T = 1.0 / 48000.0;
+
+static WDFTree* CreateRLC()
+{
+	WDFTree* tree = new WDFTree(T, 1, 1000);
+	WDFVoltageSource* vs = new WDFVoltageSource(0, 1000, "Vs");
+	WDFInductor* l = new WDFInductor(10e-3, T, "L");
+	WDFCapacitor* c1 = new WDFCapacitor(100e-9, T, "C1");
+	WDFCapacitor* c2 = new WDFCapacitor(22e-9, T, "C2");
+	WDFResistor* r2 = new WDFResistor(4700, "R2");
+	WDFVoltageSource* vb = new WDFVoltageSource(0.5, 10000, "Vb");
+	WDFSeries* s1 = new WDFSeries(vs, l, "S1");
+	WDFParallel* p1 = new WDFParallel(c2, r2, "P1");
+	WDFParallel* p2 = new WDFParallel(p1, vb, "P2");
+	WDFSeries* s2 = new WDFSeries(s1, p2, "S2");
+	WDFResistor* rt = new WDFResistor(1e5, "RT");
+	WDFRTypeAdaptor* root = new WDFRTypeAdaptor(3, 3, 4, "Root");
+	root->Connect(3, -1, s2);
+	root->Connect(3, -1, c1);
+	root->Connect(3, -1, rt);
+	root->UpdateScatteringMatrix();
+
+	WDFObject* objects[] = { vs, l, c1, c2, r2, vb, s1, p1, p2, s2, rt, root };
+	for(unsigned int i=0; i<sizeof(objects)/sizeof(objects[0]); i++)
+		tree->AddObject(objects[i]);
+	tree->SetInput(vs);
+	tree->SetRoot(root);
+	tree->SetOutput(c2);
+	return tree;
+}
+
+/**
+ Post a parameter message to both trees
+
+ @param wave the tree of the wave engine
+ @param stateSpace the tree of the state-space engine
+ @param id the id of the target
+ @param type the kind of the value
+ @param value the new value
+ */
+static void PostBoth(WDFTree* wave, WDFTree* stateSpace, string id, WDFParameterType type, double value)
+{
+	wave->PostParameter(id, type, value);
+	stateSpace->PostParameter(id, type, value);
+}
+
+/**
+ Process the same input by both engines, then compare the outputs
+
+ @param name the name of the case
+ @param oversampling the oversampling factor
+ @param bParameters true if the parameters are changed during the processing
+ @return true if the largest difference is within the tolerance
+ */
+static bool Check(const char* name, unsigned int oversampling, bool bParameters)
+{
+	WDFTree* wave = CreateRLC();
+	WDFTree* stateSpace = CreateRLC();
+	wave->SetOversampling(oversampling);
+	stateSpace->SetOversampling(oversampling);
+	if(!stateSpace->SetEngine(WDFEngine::STATE_SPACE))
+	{
+		printf("%-24s the state-space form isn't derived\n", name);
+		return false;
+	}
+
+	const unsigned int blockSize = 64;
+	float in[blockSize], outWave[blockSize], outStateSpace[blockSize];
+	double maxDiff = 0.0, peak = 0.0;
+	unsigned long n = 0;
+	for(unsigned int i=0; i<750; i++)
+	{
+		// a constant source, then the values of the elements
+		if(bParameters && i == 200)
+			PostBoth(wave, stateSpace, "Vb", WDFParameterType::VOLTAGE, -1.5);
+		if(bParameters && i == 400)
+		{
+			PostBoth(wave, stateSpace, "R2", WDFParameterType::RESISTANCE, 2200);
+			PostBoth(wave, stateSpace, "C1", WDFParameterType::CAPACITANCE, 47e-9);
+		}
+		if(bParameters && i == 600)
+		{
+			PostBoth(wave, stateSpace, "Vb", WDFParameterType::VOLTAGE, 0.25);
+			PostBoth(wave, stateSpace, "L", WDFParameterType::INDUCTANCE, 22e-3);
+		}
+
+		for(unsigned int k=0; k<blockSize; k++, n++)
+			in[k] = (float)(2.0 * sin(2.0 * M_PI * 1000.0 * n * T) + 0.5 * sin(2.0 * M_PI * 7777.0 * n * T));
+		wave->Process(in, outWave, blockSize);
+		stateSpace->Process(in, outStateSpace, blockSize);
+
+		for(unsigned int k=0; k<blockSize; k++)
+		{
+			maxDiff = fmax(maxDiff, fabs((double)outWave[k] - outStateSpace[k]));
+			peak = fmax(peak, fabs((double)outWave[k]));
+		}
+	}
+	delete wave;
+	delete stateSpace;
+
+	// both are computed in double, so only the rounding to float differs
+	const bool bPassed = (maxDiff <= 1e-5 * peak);
+	printf("%-24s max difference %.3g(peak %.3g)\n", name, maxDiff, peak);
+	return bPassed;
+}
+
+int main()
+{
+	bool bPassed = true;
+	bPassed = Check("rlc", 1, false) && bPassed;
+	bPassed = Check("rlc 4x", 4, false) && bPassed;
+	bPassed = Check("rlc with parameters", 1, true) && bPassed;
+	bPassed = Check("rlc 4x with parameters", 4, true) && bPassed;
+
+	printf(bPassed ? "PASSED\n" : "FAILED\n");
+	return bPassed ? 0 : 1;
+}
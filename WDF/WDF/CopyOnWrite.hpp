@@ -0,0 +1,92 @@
+//
+//  CopyOnWrite.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 19..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef CopyOnWrite_hpp
+#define CopyOnWrite_hpp
+
+#include <memory>
+
+/**
+ A handle of data shared by the copies of an object. Reading doesn't copy the data, and the copies never affect each other.
+ A published block is never modified: writing goes to a private draft copied from it, and Publish replaces the block atomically. So a copy can be made on another thread while the owner writes, and it keeps its own reference to a complete block.
+ The handle itself is used by one thread at a time(the owner), except that it can be copied from any thread.
+ */
+template<typename T>
+class CopyOnWrite
+{
+public:
+	/**
+	 Create a handle with default data
+	 */
+	CopyOnWrite() : data(std::make_shared<T>()) {}
+	
+	/**
+	 Copy the published data(the draft of the other is not copied)
+	 */
+	CopyOnWrite(const CopyOnWrite& other) : data(std::atomic_load(&other.data)) {}
+	
+	CopyOnWrite& operator=(const CopyOnWrite& other)
+	{
+		if(this != &other)
+		{
+			std::atomic_store(&data, std::atomic_load(&other.data));
+			draft.reset();
+		}
+		return *this;
+	}
+	
+	/**
+	 Get the data for reading(the draft while it's written)
+	 
+	 @return the data
+	 */
+	const T& operator*() const { return draft ? *draft : *data; }
+	const T* operator->() const { return draft ? draft.get() : data.get(); }
+	
+	/**
+	 Get the data for writing. The first call after Publish copies the published data to the draft.
+	 
+	 @return the draft owned by this handle only
+	 */
+	T& Write()
+	{
+		if(!draft)
+			draft = std::make_shared<T>(*data);
+		return *draft;
+	}
+	
+	/**
+	 Replace the published data by the draft, then the copies made afterwards share it
+	 */
+	void Publish()
+	{
+		if(!draft)
+			return;
+		std::atomic_store(&data, std::shared_ptr<T>(std::move(draft)));
+	}
+	
+	/**
+	 Check whether the published data is shared with other handles. It's only a hint while other threads copy or release the handles.
+	 
+	 @return true if shared
+	 */
+	bool IsShared() const { return data.use_count() > 1; }
+	
+private:
+	/**
+	 the published data(never modified)
+	 */
+	std::shared_ptr<T> data;
+	
+	/**
+	 the data being written, or NULL
+	 */
+	std::shared_ptr<T> draft;
+};
+
+#endif /* CopyOnWrite_hpp */
@@ -0,0 +1,69 @@
+//
+//  Denormal.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 12..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef Denormal_hpp
+#define Denormal_hpp
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DENORMAL_USE_SSE
+#elif defined(__aarch64__)
+#define DENORMAL_USE_AARCH64
+#endif
+
+/**
+ A class that sets the flush-to-zero and denormals-are-zero modes of the floating point unit while it exists, then restores the previous mode. Create it on the stack around the block processing.
+ */
+class DenormalGuard
+{
+public:
+	/**
+	 Save the current mode then enable FTZ/DAZ
+	 */
+	DenormalGuard()
+	{
+#if defined(DENORMAL_USE_SSE)
+		// FTZ: bit 15, DAZ: bit 6 of MXCSR
+		prevMode = _mm_getcsr();
+		_mm_setcsr(prevMode | 0x8040);
+#elif defined(DENORMAL_USE_AARCH64)
+		// FZ: bit 24 of FPCR
+		unsigned long long fpcr;
+		__asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+		prevMode = fpcr;
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ULL << 24)));
+#endif
+	}
+
+	/**
+	 Restore the previous mode
+	 */
+	~DenormalGuard()
+	{
+#if defined(DENORMAL_USE_SSE)
+		_mm_setcsr(prevMode);
+#elif defined(DENORMAL_USE_AARCH64)
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(prevMode));
+#endif
+	}
+
+private:
+	DenormalGuard(const DenormalGuard&);
+	DenormalGuard& operator=(const DenormalGuard&);
+
+	/**
+	 the mode of the floating point unit before this guard is created
+	 */
+#if defined(DENORMAL_USE_AARCH64)
+	unsigned long long prevMode;
+#else
+	unsigned int prevMode;
+#endif
+};
+
+#endif /* Denormal_hpp */
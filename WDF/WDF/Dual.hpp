@@ -0,0 +1,128 @@
+//
+//  Dual.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 28..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef Dual_hpp
+#define Dual_hpp
+
+#include <cmath>
+
+/**
+ Dual number for forward-mode automatic differentiation by N variables.
+ The device models write their currents once as a template(double or Dual), and the Jacobian is the derivative part.
+ */
+template<unsigned int N>
+class Dual
+{
+public:
+	double v;			// the value
+	double d[N];		// the partial derivatives by the variables
+
+	Dual(double value=0.0) : v(value)
+	{
+		for(unsigned int k=0; k<N; k++)
+			d[k] = 0.0;
+	}
+
+	/**
+	 The k-th variable(dv/dx_k = 1)
+	 */
+	static Dual Variable(double value, unsigned int k)
+	{
+		Dual x(value);
+		x.d[k] = 1.0;
+		return x;
+	}
+
+	/**
+	 f(x) by the value & the derivative of f at x(chain rule)
+	 */
+	Dual Chain(double value, double derivative) const
+	{
+		Dual y(value);
+		for(unsigned int k=0; k<N; k++)
+			y.d[k] = derivative * d[k];
+		return y;
+	}
+
+	Dual& operator+=(const Dual& x) { v += x.v; for(unsigned int k=0; k<N; k++) d[k] += x.d[k]; return *this; }
+	Dual& operator-=(const Dual& x) { v -= x.v; for(unsigned int k=0; k<N; k++) d[k] -= x.d[k]; return *this; }
+	Dual& operator*=(const Dual& x) { for(unsigned int k=0; k<N; k++) d[k] = d[k] * x.v + v * x.d[k]; v *= x.v; return *this; }
+	Dual& operator/=(const Dual& x) { const double inv = 1.0 / x.v; for(unsigned int k=0; k<N; k++) d[k] = (d[k] - v * inv * x.d[k]) * inv; v *= inv; return *this; }
+	Dual& operator+=(double x) { v += x; return *this; }
+	Dual& operator-=(double x) { v -= x; return *this; }
+	Dual& operator*=(double x) { v *= x; for(unsigned int k=0; k<N; k++) d[k] *= x; return *this; }
+	Dual& operator/=(double x) { return *this *= 1.0 / x; }
+};
+
+//============================================================
+// arithmetic
+//============================================================
+template<unsigned int N> inline Dual<N> operator-(const Dual<N>& x) { Dual<N> y(x); y *= -1.0; return y; }
+template<unsigned int N> inline Dual<N> operator+(Dual<N> x, const Dual<N>& y) { return x += y; }
+template<unsigned int N> inline Dual<N> operator-(Dual<N> x, const Dual<N>& y) { return x -= y; }
+template<unsigned int N> inline Dual<N> operator*(Dual<N> x, const Dual<N>& y) { return x *= y; }
+template<unsigned int N> inline Dual<N> operator/(Dual<N> x, const Dual<N>& y) { return x /= y; }
+template<unsigned int N> inline Dual<N> operator+(Dual<N> x, double y) { return x += y; }
+template<unsigned int N> inline Dual<N> operator-(Dual<N> x, double y) { return x -= y; }
+template<unsigned int N> inline Dual<N> operator*(Dual<N> x, double y) { return x *= y; }
+template<unsigned int N> inline Dual<N> operator/(Dual<N> x, double y) { return x /= y; }
+template<unsigned int N> inline Dual<N> operator+(double x, Dual<N> y) { return y += x; }
+template<unsigned int N> inline Dual<N> operator-(double x, const Dual<N>& y) { return -y + x; }
+template<unsigned int N> inline Dual<N> operator*(double x, Dual<N> y) { return y *= x; }
+template<unsigned int N> inline Dual<N> operator/(double x, const Dual<N>& y) { return y.Chain(x / y.v, -x / (y.v * y.v)); }
+
+//============================================================
+// comparison(by the value, for the branches of the models)
+//============================================================
+template<unsigned int N> inline bool operator<(const Dual<N>& x, double y) { return x.v < y; }
+template<unsigned int N> inline bool operator>(const Dual<N>& x, double y) { return x.v > y; }
+template<unsigned int N> inline bool operator<=(const Dual<N>& x, double y) { return x.v <= y; }
+template<unsigned int N> inline bool operator>=(const Dual<N>& x, double y) { return x.v >= y; }
+
+//============================================================
+// functions
+//============================================================
+template<unsigned int N> inline Dual<N> exp(const Dual<N>& x) { const double e = std::exp(x.v); return x.Chain(e, e); }
+template<unsigned int N> inline Dual<N> log(const Dual<N>& x) { return x.Chain(std::log(x.v), 1.0 / x.v); }
+template<unsigned int N> inline Dual<N> sqrt(const Dual<N>& x) { const double s = std::sqrt(x.v); return x.Chain(s, 0.5 / s); }
+template<unsigned int N> inline Dual<N> atan(const Dual<N>& x) { return x.Chain(std::atan(x.v), 1.0 / (1.0 + x.v * x.v)); }
+template<unsigned int N> inline Dual<N> sinh(const Dual<N>& x) { return x.Chain(std::sinh(x.v), std::cosh(x.v)); }
+template<unsigned int N> inline Dual<N> cosh(const Dual<N>& x) { return x.Chain(std::cosh(x.v), std::sinh(x.v)); }
+template<unsigned int N> inline Dual<N> fabs(const Dual<N>& x) { return x.Chain(std::fabs(x.v), x.v >= 0.0 ? 1.0 : -1.0); }
+
+// x^p = x^(p - 1) * x, so the power is evaluated once for both
+template<unsigned int N> inline Dual<N> pow(const Dual<N>& x, double p) { const double q = std::pow(x.v, p - 1.0); return x.Chain(q * x.v, p * q); }
+
+/**
+ Evaluate the currents of a device by dual numbers, then the Jacobian is their derivative parts
+
+ @param currents the function(const Dual<N>* V, Dual<N>* I) of the device
+ @param V the port voltages(n values)
+ @param n the number of ports(<= N)
+ @param I the port currents(n values)
+ @param J the Jacobian(J(r,c) = J[c * ld + r])
+ @param ld the leading dimension of J
+ */
+template<unsigned int N, typename Function>
+inline void DualJacobian(Function currents, const double* V, unsigned int n, double* I, double* J, unsigned int ld)
+{
+	Dual<N> v[N], i[N];
+	for(unsigned int k=0; k<n; k++)
+		v[k] = Dual<N>::Variable(V[k], k);
+
+	currents(v, i);
+
+	for(unsigned int r=0; r<n; r++)
+	{
+		I[r] = i[r].v;
+		for(unsigned int c=0; c<n; c++)
+			J[c * ld + r] = i[r].d[c];
+	}
+}
+
+#endif /* Dual_hpp */
@@ -9,11 +9,12 @@
 #include "Graph.hpp"
 #include <queue>
 #include <stack>
+#include <atomic>
 
 /**
  The index of virtual edge
  */
-unsigned int g_uiVirtualEdgeIndex = 0;
+atomic<unsigned int> g_uiVirtualEdgeIndex(0);
 
 Graph::Graph()
 {
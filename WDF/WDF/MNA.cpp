@@ -6,23 +6,564 @@
 //  Copyright © 2017년 Won Jae Lee. All rights reserved.
 //
 
+#include <cmath>
+#include <stdexcept>
+#include <set>
+#include <algorithm>
 #include "MNA.hpp"
 
+//============================================================
+// factorization(base)
+//============================================================
+MNA_Factorization::MNA_Factorization()
+{
+	n = 0;
+	norm1 = 0.0;
+}
+
+void MNA_Factorization::SetNorm1(const mat& X)
+{
+	norm1 = 0.0;
+	for(unsigned int col=0; col<X.n_cols; col++)
+	{
+		double sum = 0.0;
+		for(unsigned int row=0; row<X.n_rows; row++)
+			sum += fabs(X(row, col));
+		if(sum > norm1)
+			norm1 = sum;
+	}
+}
+
+void MNA_Factorization::SetNorm1(const std::vector<int>& Xp, const std::vector<double>& Xx)
+{
+	norm1 = 0.0;
+	for(unsigned int col=0; col+1<Xp.size(); col++)
+	{
+		double sum = 0.0;
+		for(int p=Xp[col]; p<Xp[col + 1]; p++)
+			sum += fabs(Xx[p]);
+		if(sum > norm1)
+			norm1 = sum;
+	}
+}
+
+//============================================================
+// dense LU factorization
+//============================================================
+bool MNA_LU::Factorize(const mat& X)
+{
+	n = (unsigned int)X.n_rows;
+	lu.resize(n * n);
+	pivots.resize(n);
+	SetNorm1(X);
+	
+	for(unsigned int col=0; col<n; col++)
+		for(unsigned int row=0; row<n; row++)
+			lu[col * n + row] = X(row, col);
+	
+	for(unsigned int k=0; k<n; k++)
+	{
+		// find the pivot in the column
+		double* colK = &lu[k * n];
+		unsigned int p = k;
+		for(unsigned int i=k+1; i<n; i++)
+			if(fabs(colK[i]) > fabs(colK[p]))
+				p = i;
+		
+		pivots[k] = p;
+		if(colK[p] == 0.0)
+			return false;
+		
+		// swap the rows
+		if(p != k)
+			for(unsigned int j=0; j<n; j++)
+				std::swap(lu[j * n + k], lu[j * n + p]);
+		
+		// L: the multipliers
+		const double pivot = colK[k];
+		for(unsigned int i=k+1; i<n; i++)
+			colK[i] /= pivot;
+		
+		// update the remaining columns
+		for(unsigned int j=k+1; j<n; j++)
+		{
+			double* colJ = &lu[j * n];
+			const double ukj = colJ[k];
+			if(ukj == 0.0)
+				continue;
+			for(unsigned int i=k+1; i<n; i++)
+				colJ[i] -= colK[i] * ukj;
+		}
+	}
+	
+	return true;
+}
+
+mat MNA_Factorization::Solve(const mat& B) const
+{
+	mat Z = B;
+	for(unsigned int col=0; col<Z.n_cols; col++)
+		Solve(Z.colptr(col));
+	return Z;
+}
+
+void MNA_LU::Solve(double* b) const
+{
+	// P
+	for(unsigned int k=0; k<n; k++)
+		if(pivots[k] != k)
+			std::swap(b[k], b[pivots[k]]);
+	
+	// L(unit diagonal)
+	for(unsigned int j=0; j<n; j++)
+	{
+		const double bj = b[j];
+		if(bj == 0.0)
+			continue;
+		const double* colJ = &lu[j * n];
+		for(unsigned int i=j+1; i<n; i++)
+			b[i] -= colJ[i] * bj;
+	}
+	
+	// U
+	for(unsigned int j=n; j-- > 0;)
+	{
+		const double* colJ = &lu[j * n];
+		b[j] /= colJ[j];
+		const double bj = b[j];
+		for(unsigned int i=0; i<j; i++)
+			b[i] -= colJ[i] * bj;
+	}
+}
+
+void MNA_LU::SolveTransposed(double* b) const
+{
+	// X^T = U^T * L^T * P
+	// U^T
+	for(unsigned int j=0; j<n; j++)
+	{
+		const double* colJ = &lu[j * n];
+		double sum = b[j];
+		for(unsigned int i=0; i<j; i++)
+			sum -= colJ[i] * b[i];
+		b[j] = sum / colJ[j];
+	}
+	
+	// L^T
+	for(unsigned int j=n; j-- > 0;)
+	{
+		const double* colJ = &lu[j * n];
+		double sum = b[j];
+		for(unsigned int i=j+1; i<n; i++)
+			sum -= colJ[i] * b[i];
+		b[j] = sum;
+	}
+	
+	// P^T
+	for(unsigned int k=n; k-- > 0;)
+		if(pivots[k] != k)
+			std::swap(b[k], b[pivots[k]]);
+}
+
+double MNA_Factorization::EstimateCondition() const
+{
+	if(n == 0)
+		return 0.0;
+	
+	//============================================================
+	// Hager's method as LAPACK dlacn2: maximize ||X^(-1) x||_1 over ||x||_1 = 1
+	//============================================================
+	std::vector<double> x(n, 1.0 / n), y(n), z(n);
+	double estimate = 0.0;
+	for(int iter=0; iter<5; iter++)
+	{
+		// y = X^(-1) * x
+		y = x;
+		Solve(&y[0]);
+		double norm = 0.0;
+		for(unsigned int i=0; i<n; i++)
+		{
+			norm += fabs(y[i]);
+			z[i] = (y[i] >= 0.0) ? 1.0 : -1.0;
+		}
+		
+		// stop if the unit vector doesn't increase the estimate
+		if(iter > 0 && norm <= estimate)
+			break;
+		estimate = norm;
+		
+		// z = X^(-T) * sign(y)
+		SolveTransposed(&z[0]);
+		unsigned int jMax = 0;
+		double zx = 0.0;
+		for(unsigned int i=0; i<n; i++)
+		{
+			zx += z[i] * x[i];
+			if(fabs(z[i]) > fabs(z[jMax]))
+				jMax = i;
+		}
+		
+		// converged if ||z||_inf <= z^T * x, from the first iteration
+		if(fabs(z[jMax]) <= zx)
+			break;
+		
+		for(unsigned int i=0; i<n; i++)
+			x[i] = 0.0;
+		x[jMax] = 1.0;
+	}
+	
+	// the alternating vector of dlacn2 catches the matrices for which the iteration underestimates
+	for(unsigned int i=0; i<n; i++)
+		x[i] = ((i % 2) ? -1.0 : 1.0) * (1.0 + (n > 1 ? (double)i / (n - 1) : 0.0));
+	Solve(&x[0]);
+	double alternative = 0.0;
+	for(unsigned int i=0; i<n; i++)
+		alternative += fabs(x[i]);
+	alternative = 2.0 * alternative / (3.0 * n);
+	if(alternative > estimate)
+		estimate = alternative;
+	
+	return norm1 * estimate;
+}
+
+unsigned int MNA_Factorization::GetSize() const
+{
+	return n;
+}
+
+//============================================================
+// sparse LU factorization
+//============================================================
+bool MNA_SparseLU::Factorize(const mat& X)
+{
+	// compress the columns
+	const unsigned int size = (unsigned int)X.n_rows;
+	std::vector<int> Xp(size + 1, 0), Xi;
+	std::vector<double> Xx;
+	for(unsigned int col=0; col<size; col++)
+	{
+		for(unsigned int row=0; row<size; row++)
+		{
+			const double value = X(row, col);
+			if(value != 0.0)
+			{
+				Xi.push_back(row);
+				Xx.push_back(value);
+			}
+		}
+		Xp[col + 1] = (int)Xi.size();
+	}
+	
+	return Factorize(size, Xp, Xi, Xx);
+}
+
+bool MNA_SparseLU::Factorize(unsigned int size, const std::vector<int>& Xp, const std::vector<int>& Xi, const std::vector<double>& Xx)
+{
+	n = size;
+	SetNorm1(Xp, Xx);
+	Ap = Xp;
+	Ai = Xi;
+	Ax = Xx;
+	
+	OrderColumns();
+	
+	//============================================================
+	// left-looking LU: the k-th column is x = L \ X(:, q[k]) over its reach
+	//============================================================
+	const double tolerance = 0.1;	// the diagonal is kept as pivot if |diagonal| >= tolerance * |max|
+	Lp.assign(n + 1, 0);
+	Up.assign(n + 1, 0);
+	Li.clear();		Lx.clear();
+	Ui.clear();		Ux.clear();
+	pinv.assign(n, -1);
+	
+	std::vector<double> x(n, 0.0);
+	std::vector<int> xi(n), stack(n);
+	std::vector<char> marked(n, 0);
+	for(unsigned int k=0; k<n; k++)
+	{
+		Lp[k] = (int)Li.size();
+		Up[k] = (int)Ui.size();
+		const int col = q[k];
+		
+		// sparse triangular solve
+		const int top = Reach(col, xi, stack, marked);
+		for(int p=Ap[col]; p<Ap[col + 1]; p++)
+			x[Ai[p]] = Ax[p];
+		for(int px=top; px<(int)n; px++)
+		{
+			const int j = xi[px];
+			const int J = pinv[j];
+			if(J < 0)
+				continue;
+			
+			// L has the unit diagonal at the first entry of the column
+			const double xj = x[j];
+			for(int p=Lp[J]+1; p<Lp[J + 1]; p++)
+				x[Li[p]] -= Lx[p] * xj;
+		}
+		
+		// find the pivot among the rows not pivoted yet, then store U
+		int iPivot = -1;
+		double maxValue = -1.0;
+		for(int px=top; px<(int)n; px++)
+		{
+			const int i = xi[px];
+			if(pinv[i] < 0)
+			{
+				if(fabs(x[i]) > maxValue)
+				{
+					maxValue = fabs(x[i]);
+					iPivot = i;
+				}
+			}
+			else
+			{
+				Ui.push_back(pinv[i]);
+				Ux.push_back(x[i]);
+			}
+		}
+		if(iPivot < 0 || maxValue <= 0.0)
+			return false;
+		if(pinv[col] < 0 && fabs(x[col]) >= tolerance * maxValue)
+			iPivot = col;
+		
+		// the diagonal of U is the last entry of the column
+		const double pivot = x[iPivot];
+		Ui.push_back(k);
+		Ux.push_back(pivot);
+		pinv[iPivot] = k;
+		
+		// L(the row indices are of X until all pivots are known)
+		Li.push_back(iPivot);
+		Lx.push_back(1.0);
+		for(int px=top; px<(int)n; px++)
+		{
+			const int i = xi[px];
+			if(pinv[i] < 0)
+			{
+				Li.push_back(i);
+				Lx.push_back(x[i] / pivot);
+			}
+			x[i] = 0.0;
+		}
+	}
+	Lp[n] = (int)Li.size();
+	Up[n] = (int)Ui.size();
+	
+	for(unsigned int p=0; p<Li.size(); p++)
+		Li[p] = pinv[Li[p]];
+	
+	work.resize(n);
+	
+	return true;
+}
+
+int MNA_SparseLU::Reach(int k, std::vector<int>& xi, std::vector<int>& stack, std::vector<char>& marked) const
+{
+	//============================================================
+	// the rows reachable from the nonzeros of X(:, k) in the graph of L, in topological order(xi[top..n-1])
+	//============================================================
+	int top = (int)n;
+	for(int p=Ap[k]; p<Ap[k + 1]; p++)
+	{
+		if(marked[Ai[p]])
+			continue;
+		
+		// depth-first search without recursion
+		int head = 0;
+		xi[0] = Ai[p];
+		std::vector<int>& pstack = stack;
+		while(head >= 0)
+		{
+			const int j = xi[head];
+			const int J = pinv[j];
+			if(!marked[j])
+			{
+				marked[j] = 1;
+				pstack[head] = (J < 0) ? 0 : Lp[J] + 1;
+			}
+			
+			bool done = true;
+			const int pEnd = (J < 0) ? 0 : Lp[J + 1];
+			for(int pp=pstack[head]; pp<pEnd; pp++)
+			{
+				const int i = Li[pp];
+				if(marked[i])
+					continue;
+				pstack[head] = pp;
+				xi[++head] = i;
+				done = false;
+				break;
+			}
+			
+			if(done)
+			{
+				head--;
+				xi[--top] = j;
+			}
+		}
+	}
+	
+	for(int p=top; p<(int)n; p++)
+		marked[xi[p]] = 0;
+	
+	return top;
+}
+
+void MNA_SparseLU::OrderColumns()
+{
+	//============================================================
+	// minimum degree on the graph of X + X^T: eliminate the node with the fewest neighbors,
+	// and connect its neighbors each other(fill-in)
+	//============================================================
+	std::vector< std::set<int> > adjacency(n);
+	for(unsigned int col=0; col<n; col++)
+	{
+		for(int p=Ap[col]; p<Ap[col + 1]; p++)
+		{
+			const int row = Ai[p];
+			if(row == (int)col)
+				continue;
+			adjacency[row].insert(col);
+			adjacency[col].insert(row);
+		}
+	}
+	
+	q.resize(n);
+	std::vector<char> eliminated(n, 0);
+	for(unsigned int k=0; k<n; k++)
+	{
+		int iMin = -1;
+		for(unsigned int i=0; i<n; i++)
+			if(!eliminated[i] && (iMin < 0 || adjacency[i].size() < adjacency[iMin].size()))
+				iMin = i;
+		
+		q[k] = iMin;
+		eliminated[iMin] = 1;
+		
+		const std::set<int>& neighbors = adjacency[iMin];
+		for(std::set<int>::const_iterator i = neighbors.begin(); i != neighbors.end(); i++)
+		{
+			adjacency[*i].erase(iMin);
+			for(std::set<int>::const_iterator j = neighbors.begin(); j != neighbors.end(); j++)
+				if(*i != *j)
+					adjacency[*i].insert(*j);
+		}
+		adjacency[iMin].clear();
+	}
+}
+
+void MNA_SparseLU::Solve(double* b) const
+{
+	// P
+	for(unsigned int i=0; i<n; i++)
+		work[pinv[i]] = b[i];
+	
+	// L(unit diagonal at the first entry)
+	for(unsigned int j=0; j<n; j++)
+	{
+		const double xj = work[j];
+		if(xj == 0.0)
+			continue;
+		for(int p=Lp[j]+1; p<Lp[j + 1]; p++)
+			work[Li[p]] -= Lx[p] * xj;
+	}
+	
+	// U(diagonal at the last entry)
+	for(unsigned int j=n; j-- > 0;)
+	{
+		work[j] /= Ux[Up[j + 1] - 1];
+		const double xj = work[j];
+		if(xj == 0.0)
+			continue;
+		for(int p=Up[j]; p<Up[j + 1]-1; p++)
+			work[Ui[p]] -= Ux[p] * xj;
+	}
+	
+	// Q
+	for(unsigned int k=0; k<n; k++)
+		b[q[k]] = work[k];
+}
+
+void MNA_SparseLU::SolveTransposed(double* b) const
+{
+	// X = P^T * L * U * Q^T, X^T = Q * U^T * L^T * P
+	// Q^T
+	for(unsigned int k=0; k<n; k++)
+		work[k] = b[q[k]];
+	
+	// U^T
+	for(unsigned int j=0; j<n; j++)
+	{
+		double sum = work[j];
+		for(int p=Up[j]; p<Up[j + 1]-1; p++)
+			sum -= Ux[p] * work[Ui[p]];
+		work[j] = sum / Ux[Up[j + 1] - 1];
+	}
+	
+	// L^T
+	for(unsigned int j=n; j-- > 0;)
+	{
+		double sum = work[j];
+		for(int p=Lp[j]+1; p<Lp[j + 1]; p++)
+			sum -= Lx[p] * work[Li[p]];
+		work[j] = sum;
+	}
+	
+	// P^T
+	for(unsigned int i=0; i<n; i++)
+		b[i] = work[pinv[i]];
+}
+
+unsigned int MNA_SparseLU::GetFactorNonzeros() const
+{
+	return (unsigned int)(Li.size() + Ui.size());
+}
+
 //============================================================
 // MNA
 //============================================================
-MNA::MNA(mat Y, mat A, mat B, mat D) : Y(Y), A(A), B(B), D(D), iVs(0)
+static void AddEntries(std::vector<MNA_Entry>& entries, const mat& M, unsigned int rowOffset, unsigned int colOffset)
 {
+	for(unsigned int col=0; col<M.n_cols; col++)
+		for(unsigned int row=0; row<M.n_rows; row++)
+			if(M(row, col) != 0.0)
+				entries.push_back(MNA_Entry(rowOffset + row, colOffset + col, M(row, col)));
+}
+
+MNA::MNA(mat Y, mat A, mat B, mat D)
+{
+	MNA_System& sys = system.Write();
+	sys.nNodes = (unsigned int)Y.n_cols;
+	sys.nVoltageSources = (unsigned int)B.n_rows;
+	AddEntries(sys.entries, Y, 0, 0);
+	AddEntries(sys.entries, A, 0, sys.nNodes);
+	AddEntries(sys.entries, B, sys.nNodes, 0);
+	AddEntries(sys.entries, D, sys.nNodes, sys.nNodes);
+	sys.iVs = 0;
+	sys.condition = 0.0;
+	sys.bSparse = false;
+	bStamping = false;
+	backend = MNA_Backend::AUTO;
+	
 	SetSystemMatrix();
+	system.Publish();
 }
 
-MNA::MNA(unsigned int nNodes, unsigned int nVoltageSources) : iVs(0)
+MNA::MNA(unsigned int nNodes, unsigned int nVoltageSources)
 {
-	X = zeros<mat>(nNodes+nVoltageSources, nNodes+nVoltageSources);
-	Y = zeros<mat>(nNodes, nNodes);
-	A = zeros<mat>(nNodes, nVoltageSources);
-	B = zeros<mat>(nVoltageSources, nNodes);
-	D = zeros<mat>(nVoltageSources, nVoltageSources);
+	MNA_System& sys = system.Write();
+	sys.nNodes = nNodes;
+	sys.nVoltageSources = nVoltageSources;
+	sys.iVs = 0;
+	sys.condition = 0.0;
+	sys.bSparse = false;
+	bStamping = false;
+	backend = MNA_Backend::AUTO;
+	
+	SetSystemMatrix();
+	system.Publish();
 }
 
 MNA::~MNA()
@@ -32,51 +573,185 @@ MNA::~MNA()
 
 void MNA::Add(MNA_Stamp_Resistor resistor)
 {
-	int i = resistor.i;
-	int j = resistor.j;
-	double G = resistor.G;
+	MNA_System& sys = system.Write();
+	sys.resistors.push_back(resistor);
 	
-	if(i >= 0)				Y(i,i) = Y(i,i) + G;
-	if(j >= 0)				Y(j,j) = Y(j,j) + G;
-	if(i >= 0 && j >= 0)	Y(i,j) = Y(i,j) - G;
-	if(i >= 0 && j >= 0)	Y(j,i) = Y(j,i) - G;
+	// the stamps are assembled & published at once by EndStamp
+	if(bStamping)
+		return;
 	
-	SetSystemMatrix();
+	// a new entry changes the pattern of the sparse X
+	if(sys.bSparse)
+		SetSystemMatrix();
+	else
+		StampConductance(sys, (unsigned int)sys.resistors.size()-1, resistor.G);
+	system.Publish();
 }
 
 void MNA::Add(MNA_Stamp_VoltageSource vs)
 {
+	MNA_System& sys = system.Write();
+	const unsigned int first = (unsigned int)sys.entries.size();
+	const int iRow = (int)(sys.nNodes + sys.iVs);
 	if(vs.plus >= 0)
 	{
-		A(vs.plus, iVs) = 1;
-		B(iVs, vs.plus) = 1;
+		sys.entries.push_back(MNA_Entry(vs.plus, iRow, 1));
+		sys.entries.push_back(MNA_Entry(iRow, vs.plus, 1));
 	}
 	
 	if(vs.minus >= 0)
 	{
-		A(vs.minus, iVs) = -1;
-		B(iVs, vs.minus) = -1;
+		sys.entries.push_back(MNA_Entry(vs.minus, iRow, -1));
+		sys.entries.push_back(MNA_Entry(iRow, vs.minus, -1));
 	}
 	
+	sys.iVs++;
+	
+	if(bStamping)
+		return;
+	
+	if(sys.bSparse)
+		SetSystemMatrix();
+	else
+		for(unsigned int k=first; k<sys.entries.size(); k++)
+			sys.X(sys.entries[k].row, sys.entries[k].col) = sys.entries[k].value;
+	system.Publish();
+}
+
+void MNA::BeginStamp()
+{
+	bStamping = true;
+}
+
+void MNA::EndStamp()
+{
+	if(!bStamping)
+		return;
+	
+	bStamping = false;
 	SetSystemMatrix();
-	iVs++;
+	system.Publish();
+}
+
+void MNA::SetConductance(unsigned int iResistor, double G, bool bPublish)
+{
+	if(iResistor >= system->resistors.size() || system->resistors[iResistor].G == G)
+		return;
+	
+	MNA_System& sys = system.Write();
+	MNA_Stamp_Resistor& resistor = sys.resistors[iResistor];
+	
+	// stamp the difference(X is assembled from the stamps while stamping)
+	if(!bStamping)
+		StampConductance(sys, iResistor, G - resistor.G);
+	resistor.G = G;
+	
+	if(bPublish && !bStamping)
+		system.Publish();
+}
+
+void MNA::SetBackend(MNA_Backend backend)
+{
+	if(this->backend == backend)
+		return;
+	
+	// X is stored for the backend
+	this->backend = backend;
+	if(!bStamping)
+	{
+		SetSystemMatrix();
+		system.Publish();
+	}
+}
+
+bool MNA::IsSparse()
+{
+	return system->bSparse;
+}
+
+unsigned int MNA::GetSystemSize()
+{
+	return system->nNodes + system->nVoltageSources;
+}
+
+mat MNA::SolvePortBlock(unsigned int nPorts)
+{
+	// the stamps & the results of the factorization are published at once
+	MNA_System& sys = system.Write();
+	if(bStamping)
+	{
+		bStamping = false;
+		SetSystemMatrix();
+	}
+	
+	// the factorization isn't kept: a copy of this object would copy it
+	const unsigned int n = sys.nNodes + sys.nVoltageSources;
+	MNA_LU denseLU;
+	MNA_SparseLU sparseLU;
+	MNA_Factorization& factorization = sys.bSparse ? (MNA_Factorization&)sparseLU : (MNA_Factorization&)denseLU;
+	const bool bFactorized = sys.bSparse ? sparseLU.Factorize(n, sys.Xp, sys.Xi, sys.Xx) : denseLU.Factorize(sys.X);
+	if(!bFactorized)
+		throw std::runtime_error("MNA: the system matrix is singular");
+	
+	// the columns of [0 I]^T
+	const unsigned int offset = n - nPorts;
+	mat Z = zeros<mat>(nPorts, nPorts);
+	std::vector<double> column(n);
+	for(unsigned int j=0; j<nPorts; j++)
+	{
+		for(unsigned int i=0; i<n; i++)
+			column[i] = 0.0;
+		column[offset + j] = 1.0;
+		
+		factorization.Solve(&column[0]);
+		
+		// the rows of [0 I]
+		for(unsigned int i=0; i<nPorts; i++)
+			Z(i, j) = column[offset + i];
+	}
+	
+	sys.condition = factorization.EstimateCondition();
+	system.Publish();
+	
+	return Z;
+}
+
+double MNA::GetConditionNumber()
+{
+	return system->condition;
+}
+
+unsigned int MNA::GetResistorCount()
+{
+	return (unsigned int)system->resistors.size();
+}
+
+static mat GetBlock(const mat& X, unsigned int row, unsigned int col, unsigned int nRows, unsigned int nCols)
+{
+	mat block(nRows, nCols);
+	for(unsigned int c=0; c<nCols; c++)
+		for(unsigned int r=0; r<nRows; r++)
+			block(r, c) = X(row + r, col + c);
+	return block;
 }
 
 void MNA::Print(int option)
 {
+	const mat X = GetDenseSystemMatrix();
+	const unsigned int nNodes = system->nNodes, nVS = system->nVoltageSources;
 	switch(option)
 	{
 		case 1:
-			Y.print("Y:");
+			GetBlock(X, 0, 0, nNodes, nNodes).print("Y:");
 			break;
 		case 2:
-			A.print("A:");
+			GetBlock(X, 0, nNodes, nNodes, nVS).print("A:");
 			break;
 		case 3:
-			B.print("B:");
+			GetBlock(X, nNodes, 0, nVS, nNodes).print("B:");
 			break;
 		case 4:
-			D.print("D:");
+			GetBlock(X, nNodes, nNodes, nVS, nVS).print("D:");
 			break;
 		default:
 			X.print("X:");
@@ -84,31 +759,115 @@ void MNA::Print(int option)
 	}
 }
 
+mat MNA::GetDenseSystemMatrix()
+{
+	const MNA_System& sys = *system;
+	if(!sys.bSparse)
+		return sys.X;
+	
+	const unsigned int size = sys.nNodes + sys.nVoltageSources;
+	mat X = zeros<mat>(size, size);
+	for(unsigned int col=0; col<size; col++)
+		for(int p=sys.Xp[col]; p<sys.Xp[col + 1]; p++)
+			X(sys.Xi[p], col) = sys.Xx[p];
+	return X;
+}
+
 void MNA::SetSystemMatrix()
 {
 	// X = [ [Y, A], [B, D] ]
-	uword nNodes = Y.n_cols;
-	uword nVS = B.n_rows;
-	uword size = nNodes + nVS;
+	MNA_System& sys = system.Write();
+	const unsigned int size = sys.nNodes + sys.nVoltageSources;
 	
-	for(unsigned int row=0; row<size; row++)
+	//============================================================
+	// the entries, then (i,i), (j,j), (i,j) & (j,i) of each resistor, in order of the stamps
+	//============================================================
+	const unsigned int nEntries = (unsigned int)sys.entries.size();
+	std::vector<MNA_Entry> triplets(sys.entries);
+	for(unsigned int k=0; k<sys.resistors.size(); k++)
 	{
-		for(unsigned int col=0; col<size; col++)
+		const MNA_Stamp_Resistor& resistor = sys.resistors[k];
+		triplets.push_back(MNA_Entry(resistor.i, resistor.i, resistor.G));
+		triplets.push_back(MNA_Entry(resistor.j, resistor.j, resistor.G));
+		triplets.push_back(MNA_Entry(resistor.i, resistor.j, -resistor.G));
+		triplets.push_back(MNA_Entry(resistor.j, resistor.i, -resistor.G));
+	}
+	
+	// column by column, then row by row(the duplicates are summed in order of the stamps)
+	std::vector<unsigned int> order;
+	order.reserve(triplets.size());
+	for(unsigned int t=0; t<triplets.size(); t++)
+		if(triplets[t].row >= 0 && triplets[t].col >= 0)
+			order.push_back(t);
+	std::stable_sort(order.begin(), order.end(), [&triplets](unsigned int a, unsigned int b)
+	{
+		return (triplets[a].col != triplets[b].col) ? (triplets[a].col < triplets[b].col) : (triplets[a].row < triplets[b].row);
+	});
+	
+	//============================================================
+	// compressed sparse columns
+	//============================================================
+	sys.Xp.assign(size + 1, 0);
+	sys.Xi.clear();
+	sys.Xx.clear();
+	sys.positions.assign(4 * sys.resistors.size(), -1);
+	for(unsigned int k=0; k<order.size(); k++)
+	{
+		const MNA_Entry& entry = triplets[order[k]];
+		if(k == 0 || entry.col != triplets[order[k-1]].col || entry.row != triplets[order[k-1]].row)
 		{
-			if(col < nNodes)
-			{
-				if(row < nNodes)
-					X(row, col) = Y(row, col);
-				else
-					X(row, col) = B(row-nNodes, col);
-			}
-			else
-			{
-				if(row < nNodes)
-					X(row, col) = A(row, col-nNodes);
-				else
-					X(row, col) = D(row-nNodes, col-nNodes);
-			}
+			sys.Xi.push_back(entry.row);
+			sys.Xx.push_back(entry.value);
+			sys.Xp[entry.col + 1]++;
 		}
+		else
+			sys.Xx.back() += entry.value;
+		
+		if(order[k] >= nEntries)
+			sys.positions[order[k] - nEntries] = (int)sys.Xx.size()-1;
+	}
+	for(unsigned int col=0; col<size; col++)
+		sys.Xp[col + 1] += sys.Xp[col];
+	
+	// the sparse backend pays off only for the large & sparse system
+	const unsigned int nNonzeros = (unsigned int)sys.Xi.size();
+	sys.bSparse = (backend == MNA_Backend::SPARSE);
+	if(backend == MNA_Backend::AUTO && size >= MNA_SPARSE_MIN_SIZE)
+		sys.bSparse = ((double)nNonzeros / ((double)size * size) <= MNA_SPARSE_MAX_DENSITY);
+	
+	if(sys.bSparse)
+	{
+		sys.X = mat();
+		return;
 	}
+	
+	// the small or dense system is kept dense
+	sys.X = zeros<mat>(size, size);
+	for(unsigned int col=0; col<size; col++)
+		for(int p=sys.Xp[col]; p<sys.Xp[col + 1]; p++)
+			sys.X(sys.Xi[p], col) = sys.Xx[p];
+	sys.Xp.clear();
+	sys.Xi.clear();
+	sys.Xx.clear();
+	sys.positions.clear();
+}
+
+void MNA::StampConductance(MNA_System& sys, unsigned int iResistor, double G)
+{
+	const int i = sys.resistors[iResistor].i, j = sys.resistors[iResistor].j;
+	if(sys.bSparse)
+	{
+		// (i,i), (j,j), (i,j), (j,i)
+		const int* position = &sys.positions[4 * iResistor];
+		if(position[0] >= 0)	sys.Xx[position[0]] += G;
+		if(position[1] >= 0)	sys.Xx[position[1]] += G;
+		if(position[2] >= 0)	sys.Xx[position[2]] -= G;
+		if(position[3] >= 0)	sys.Xx[position[3]] -= G;
+		return;
+	}
+	
+	if(i >= 0)				sys.X(i,i) = sys.X(i,i) + G;
+	if(j >= 0)				sys.X(j,j) = sys.X(j,j) + G;
+	if(i >= 0 && j >= 0)	sys.X(i,j) = sys.X(i,j) - G;
+	if(i >= 0 && j >= 0)	sys.X(j,i) = sys.X(j,i) - G;
 }
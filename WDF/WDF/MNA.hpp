@@ -9,7 +9,9 @@
 #ifndef MNA_hpp
 #define MNA_hpp
 
+#include <vector>
 #include "armadillo"
+#include "CopyOnWrite.hpp"
 
 using namespace arma;
 
@@ -38,6 +40,134 @@ public:
 	int plus, minus;	// the number of nodes
 };
 
+//============================================================
+// an entry of X which isn't changed by the resistors(the voltage sources & the matrices given)
+//============================================================
+class MNA_Entry
+{
+public:
+	MNA_Entry(int row, int col, double value) : row(row), col(col), value(value) {}
+	~MNA_Entry() {}
+	
+	int row, col;
+	double value;
+};
+
+//============================================================
+// the size & the density from which the sparse factorization is used(MNA_Backend::AUTO)
+//============================================================
+#define MNA_SPARSE_MIN_SIZE			48
+#define MNA_SPARSE_MAX_DENSITY		0.1
+
+//============================================================
+// backend of the factorization
+//============================================================
+enum class MNA_Backend
+{
+	AUTO,		// selected by the size & the number of the stamped entries of X
+	DENSE,
+	SPARSE
+};
+
+//============================================================
+// factorization of a square matrix(base class of dense & sparse LU)
+// a factorization is reused by all products of the same matrix
+//============================================================
+class MNA_Factorization
+{
+public:
+	MNA_Factorization();
+	virtual ~MNA_Factorization() {}
+	
+	virtual bool Factorize(const mat& X) = 0;		// false if X is singular
+	virtual void Solve(double* b) const = 0;		// b = X^(-1) * b
+	virtual void SolveTransposed(double* b) const = 0;	// b = X^(-T) * b
+	
+	mat Solve(const mat& B) const;					// X^(-1) * B
+	double EstimateCondition() const;				// 1-norm condition number estimate(Hager's method)
+	unsigned int GetSize() const;
+	
+protected:
+	unsigned int n;						// the size of the matrix
+	double norm1;						// the 1-norm of X
+	
+	void SetNorm1(const mat& X);
+	void SetNorm1(const std::vector<int>& Xp, const std::vector<double>& Xx);
+};
+
+//============================================================
+// dense LU factorization with partial pivoting(PA = LU)
+//============================================================
+class MNA_LU : public MNA_Factorization
+{
+public:
+	MNA_LU() {}
+	virtual ~MNA_LU() {}
+	
+	virtual bool Factorize(const mat& X);
+	virtual void Solve(double* b) const;
+	virtual void SolveTransposed(double* b) const;
+	using MNA_Factorization::Solve;
+	
+protected:
+	std::vector<double> lu;				// L(unit lower) & U, column-major
+	std::vector<unsigned int> pivots;	// row k is swapped with row pivots[k] at the k-th step
+};
+
+//============================================================
+// sparse LU factorization(PXQ = LU, left-looking)
+// the columns are ordered by the minimum degree of the pattern of X + X^T to reduce the fill-in,
+// and the rows are pivoted by threshold partial pivoting which prefers the diagonal.
+//============================================================
+class MNA_SparseLU : public MNA_Factorization
+{
+public:
+	MNA_SparseLU() {}
+	virtual ~MNA_SparseLU() {}
+	
+	virtual bool Factorize(const mat& X);
+	virtual void Solve(double* b) const;
+	virtual void SolveTransposed(double* b) const;
+	using MNA_Factorization::Solve;
+	
+	// factorize X given in compressed sparse columns(the rows of each column in ascending order)
+	bool Factorize(unsigned int size, const std::vector<int>& Xp, const std::vector<int>& Xi, const std::vector<double>& Xx);
+	
+	unsigned int GetFactorNonzeros() const;		// the number of nonzeros in L & U
+	
+protected:
+	// compressed sparse columns
+	std::vector<int> Ap, Ai, Lp, Li, Up, Ui;
+	std::vector<double> Ax, Lx, Ux;
+	std::vector<int> q;				// column order: the k-th column of LU is the column q[k] of X
+	std::vector<int> pinv;			// row i of X is the row pinv[i] of LU
+	mutable std::vector<double> work;
+	
+	void OrderColumns();			// minimum degree ordering of X + X^T
+	int Reach(int k, std::vector<int>& xi, std::vector<int>& stack, std::vector<char>& marked) const;
+};
+
+//============================================================
+// the stamps & the system matrix of MNA(shared by the copies until changed)
+// X is stored in compressed sparse columns for the sparse backend, so neither a stamp nor a copy touches n^2 entries
+//============================================================
+class MNA_System
+{
+public:
+	unsigned int nNodes, nVoltageSources;		// X = [ [Y, A], [B, D] ] is (nNodes + nVoltageSources) square
+	unsigned int iVs;	// the index as which the voltage source is added
+	std::vector<MNA_Stamp_Resistor> resistors;	// the stamps of resistors in order of addition
+	std::vector<MNA_Entry> entries;				// the entries of the voltage sources & the matrices given
+	
+	bool bSparse;		// true if X is stored in Xp, Xi & Xx, and factorized by the sparse LU
+	mat X;				// system matrix(dense only)
+	std::vector<int> Xp, Xi;					// compressed sparse columns of X(sparse only)
+	std::vector<double> Xx;
+	std::vector<int> positions;					// the positions in Xx of (i,i), (j,j), (i,j) & (j,i) of each resistor(-1 if not stamped)
+	
+	double condition;	// the condition number estimated by the last factorization of X(0 if not factorized)
+};
+
 //============================================================
 // MNA
 //============================================================
@@ -51,14 +181,42 @@ public:
 	void Add(MNA_Stamp_Resistor);
 	void Add(MNA_Stamp_VoltageSource);
 	
+	// collect the stamps without updating X, then assemble X once at EndStamp(for building a large system)
+	void BeginStamp();
+	void EndStamp();
+	
+	// solve X * Z = [0 I]^T, then return the last nPorts rows of Z(= [0 I] * X^(-1) * [0 I]^T) without the inverse of X
+	// the factorization is local, only its condition estimate is kept in the system
+	mat SolvePortBlock(unsigned int nPorts);
+	
+	// the condition number of X estimated from the last factorization(0 if not factorized)
+	double GetConditionNumber();
+	
+	// select the backend of the factorization(and the storage of X)
+	void SetBackend(MNA_Backend backend);
+	bool IsSparse();						// true if X is stored & factorized as sparse
+	unsigned int GetSystemSize();			// the number of rows of X
+	
+	// change the conductance of the resistor added at iResistor-th order(only the changed entries are re-stamped)
+	// the change is published by SolvePortBlock if bPublish is false(to publish several changes at once)
+	void SetConductance(unsigned int iResistor, double G, bool bPublish=true);
+	unsigned int GetResistorCount();
+	
 	void Print(int option=0);
 	
 protected:
-	mat X;				// system matrix
-	mat Y,A,B,D;		// impedances, voltage sources and nonlinear sources
-	unsigned int iVs;	// the index as which the voltage source is added
+	CopyOnWrite<MNA_System> system;
+	bool bStamping;		// true between BeginStamp and EndStamp
+	MNA_Backend backend;	// the backend selected
 	
+	// assemble X from the stamps, dense or sparse by the backend
 	void SetSystemMatrix();
+	
+	// stamp the conductance of the resistor to X in place
+	void StampConductance(MNA_System& sys, unsigned int iResistor, double G);
+	
+	// the dense copy of X(for printing)
+	mat GetDenseSystemMatrix();
 };
 
 #endif /* MNA_hpp */
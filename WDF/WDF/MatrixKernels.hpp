@@ -0,0 +1,145 @@
+//
+//  MatrixKernels.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 26..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef MatrixKernels_hpp
+#define MatrixKernels_hpp
+
+#include <cmath>
+#include <utility>
+
+// the largest size of the matrix processed by the fixed-size kernels
+#define MAX_FIXED_KERNEL_SIZE	8
+
+/**
+ y = A * x(or y += A * x if bAccumulate), A is a rows x cols matrix stored in column-major order.
+ */
+typedef void (*MatVecKernel)(const double* A, const double* x, double* y, unsigned int rows, unsigned int cols, bool bAccumulate);
+
+/**
+ The fallback for any size
+ */
+inline void MatVecDynamic(const double* A, const double* x, double* y, unsigned int rows, unsigned int cols, bool bAccumulate)
+{
+	if(!bAccumulate)
+		for(unsigned int r=0; r<rows; r++)
+			y[r] = 0.0;
+
+	for(unsigned int c=0; c<cols; c++)
+	{
+		const double xc = x[c];
+		const double* col = A + c * rows;
+		for(unsigned int r=0; r<rows; r++)
+			y[r] += col[r] * xc;
+	}
+}
+
+/**
+ The kernel for the size known at compile time. The loops are fully unrolled and the columns are accumulated in registers, so the compiler vectorizes them.
+ */
+template<unsigned int R, unsigned int C>
+inline void MatVecFixed(const double* A, const double* x, double* y, unsigned int, unsigned int, bool bAccumulate)
+{
+	double sum[R];
+	for(unsigned int r=0; r<R; r++)
+		sum[r] = bAccumulate ? y[r] : 0.0;
+
+	for(unsigned int c=0; c<C; c++)
+	{
+		const double xc = x[c];
+		for(unsigned int r=0; r<R; r++)
+			sum[r] += A[c * R + r] * xc;
+	}
+
+	for(unsigned int r=0; r<R; r++)
+		y[r] = sum[r];
+}
+
+template<size_t... I>
+inline const MatVecKernel* MatVecKernelTable(std::index_sequence<I...>)
+{
+	// (rows - 1) * MAX_FIXED_KERNEL_SIZE + (cols - 1)
+	static const MatVecKernel table[] = { &MatVecFixed<I / MAX_FIXED_KERNEL_SIZE + 1, I % MAX_FIXED_KERNEL_SIZE + 1>... };
+	return table;
+}
+
+/**
+ Select the kernel for the size. It is called when the size of the matrix is changed, not per sample.
+
+ @param rows the number of rows
+ @param cols the number of columns
+ @return the fixed-size kernel if both sizes are in [1, MAX_FIXED_KERNEL_SIZE], otherwise the fallback
+ */
+inline MatVecKernel GetMatVecKernel(unsigned int rows, unsigned int cols)
+{
+	if(rows == 0 || cols == 0 || rows > MAX_FIXED_KERNEL_SIZE || cols > MAX_FIXED_KERNEL_SIZE)
+		return &MatVecDynamic;
+
+	static const MatVecKernel* table = MatVecKernelTable(std::make_index_sequence<MAX_FIXED_KERNEL_SIZE * MAX_FIXED_KERNEL_SIZE>());
+	return table[(rows - 1) * MAX_FIXED_KERNEL_SIZE + (cols - 1)];
+}
+
+/**
+ LU factorization of the small n x n matrix in place(column-major, partial pivoting)
+
+ @param A the matrix, replaced by L(unit diagonal) & U
+ @param n the size
+ @param pivots the row swapped with the k-th row at k-th step(n values)
+ @return false if the matrix is singular
+ */
+inline bool LUFactorizeInPlace(double* A, unsigned int n, unsigned int* pivots)
+{
+	for(unsigned int k=0; k<n; k++)
+	{
+		unsigned int p = k;
+		for(unsigned int i=k+1; i<n; i++)
+			if(fabs(A[k * n + i]) > fabs(A[k * n + p]))
+				p = i;
+		pivots[k] = p;
+		if(A[k * n + p] == 0.0)
+			return false;
+
+		if(p != k)
+			for(unsigned int j=0; j<n; j++)
+				std::swap(A[j * n + k], A[j * n + p]);
+
+		const double pivot = A[k * n + k];
+		for(unsigned int i=k+1; i<n; i++)
+			A[k * n + i] /= pivot;
+		for(unsigned int j=k+1; j<n; j++)
+		{
+			const double ukj = A[j * n + k];
+			for(unsigned int i=k+1; i<n; i++)
+				A[j * n + i] -= A[k * n + i] * ukj;
+		}
+	}
+
+	return true;
+}
+
+/**
+ Solve A * x = b in place by the factorization of LUFactorizeInPlace
+ */
+inline void LUSolveInPlace(const double* LU, unsigned int n, const unsigned int* pivots, double* b)
+{
+	for(unsigned int k=0; k<n; k++)
+		if(pivots[k] != k)
+			std::swap(b[k], b[pivots[k]]);
+
+	for(unsigned int j=0; j<n; j++)
+		for(unsigned int i=j+1; i<n; i++)
+			b[i] -= LU[j * n + i] * b[j];
+
+	for(unsigned int j=n; j-- > 0;)
+	{
+		b[j] /= LU[j * n + j];
+		for(unsigned int i=0; i<j; i++)
+			b[i] -= LU[j * n + i] * b[j];
+	}
+}
+
+#endif /* MatrixKernels_hpp */
@@ -14,6 +14,10 @@ NewtonRaphson::NewtonRaphson()
 {
 	totalIter = 0;
 	nSamples = 0;
+	solverMaxIter = 100;
+	solverEpsilon = 1e-9;
+	bWarmStart = false;
+	lastSolution = 0.0;
 }
 
 NewtonRaphson::~NewtonRaphson()
@@ -42,6 +46,7 @@ double NewtonRaphson::Solve(double guess, int max_iter, double epsilon)
 	
 	totalIter += iter;
 	nSamples++;
+	lastSolution = x;
 	
 	return x;
 }
@@ -51,13 +56,38 @@ double NewtonRaphson::GetAvgIter()
 	return (double)totalIter / (double)nSamples;
 }
 
+void NewtonRaphson::SetSolverLimits(int max_iter, double epsilon)
+{
+	solverMaxIter = max_iter;
+	solverEpsilon = epsilon;
+}
+
+void NewtonRaphson::SetWarmStart(bool enable)
+{
+	bWarmStart = enable;
+}
+
+double NewtonRaphson::GetGuess(double guess)
+{
+	return bWarmStart ? lastSolution : guess;
+}
+
 double NewtonRaphson::Iterate(double x, double dx)
 {
-	double f = Evaluate(x);
+	double f, df;
+	if(EvaluateWithDerivative(x, f, df))
+		return x - f / df;
+	
+	f = Evaluate(x);
 	double xnew = x - dx*f / (Evaluate(x + dx) - f);
 	return xnew;
 }
 
+bool NewtonRaphson::EvaluateWithDerivative(double x, double& f, double& df)
+{
+	return false;
+}
+
 //============================================================
 // Broyden's method
 //============================================================
@@ -25,12 +25,29 @@ public:
 	virtual double Solve(double guess, int max_iter=100, double epsilon=1e-9);
 	double GetAvgIter();
 	
+	// set the limits used by the owner when it solves(quality scaling)
+	void SetSolverLimits(int max_iter, double epsilon);
+	
+	// start from the solution of the previous sample instead of the guess of the owner
+	void SetWarmStart(bool enable);
+	
 protected:
 	virtual double Iterate(double x, double dx=1e-6);
 	virtual double Evaluate(double x) = 0;
 	
+	// f = F(x) & df = F'(x) at once, false if not given(the step uses the finite difference)
+	virtual bool EvaluateWithDerivative(double x, double& f, double& df);
+	
+	double GetGuess(double guess);	// the previous solution if warm-started, otherwise the guess
+	
 	unsigned int totalIter;
 	unsigned int nSamples;
+	
+	bool bWarmStart;
+	double lastSolution;		// the solution of the previous sample
+	
+	int solverMaxIter;			// the maximum number of iterations
+	double solverEpsilon;		// the relative error at which the iteration stops
 };
 
 //============================================================
@@ -0,0 +1,833 @@
+//
+//  NonlinearSolver.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 27..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <cmath>
+#include "NonlinearSolver.hpp"
+#include "MatrixKernels.hpp"
+
+static double Norm2(const double* x, unsigned int n)
+{
+	double sum = 0.0;
+	for(unsigned int i=0; i<n; i++)
+		sum += x[i] * x[i];
+	return sqrt(sum);
+}
+
+//============================================================
+// base class of the solvers
+//============================================================
+NonlinearSolver::NonlinearSolver()
+{
+	nWork = 0;
+	budget = 0;
+	fallback = NonlinearFallback::NONE;
+	bLimiting = false;
+	bLimitingSet = false;
+	bValidJ = false;
+	ResetStats();
+}
+
+NonlinearSolver::~NonlinearSolver()
+{
+	
+}
+
+NonlinearSolver* NonlinearSolver::Create(NonlinearSolverType type)
+{
+	switch(type)
+	{
+		case NonlinearSolverType::CHORD:			return new ChordSolver();
+		case NonlinearSolverType::DAMPED_NEWTON:	return new DampedNewtonSolver();
+		case NonlinearSolverType::BROYDEN:			return new BroydenSolver();
+		case NonlinearSolverType::FIXED_POINT:		return new FixedPointSolver();
+		case NonlinearSolverType::TABULATED:		return new TabulatedSolver();
+		case NonlinearSolverType::NEWTON:
+		default:									return new NewtonSolver();
+	}
+}
+
+int NonlinearSolver::Solve(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon)
+{
+	Reserve(n);
+	
+	// the worst case is bounded by the budget
+	if(budget > 0 && max_iter > (int)budget)
+		max_iter = budget;
+	
+	// the guess is limited from the previous solution(e.g. the prediction far in the forward region)
+	if(bLimiting)
+		system.LimitStep(&workPrev[0], x);
+	for(unsigned int i=0; i<n; i++)
+		workGuess[i] = x[i];
+	
+	bool bConverged = true;
+	int iter = Run(system, x, n, max_iter, epsilon, bConverged);
+	
+	stats.nSolves++;
+	stats.nIterations += iter;
+	
+	double guessError = 0.0;
+	for(unsigned int i=0; i<n; i++)
+		guessError += (x[i] - workGuess[i]) * (x[i] - workGuess[i]);
+	stats.totalGuessError += sqrt(guessError);
+	if((unsigned int)iter > stats.maxIterations)
+		stats.maxIterations = iter;
+	
+	if(bConverged)
+	{
+		for(unsigned int i=0; i<n; i++)
+			workPrev[i] = x[i];
+	}
+	else
+	{
+		stats.nFailures++;
+		if(iter >= max_iter)
+			stats.nBudgetHits++;
+		ApplyFallback(system, x);
+	}
+	
+	return iter;
+}
+
+void NonlinearSolver::Prepare(NonlinearSystem& system, unsigned int n)
+{
+	Reserve(n);
+	bValidJ = false;
+	
+	// the circuit at rest
+	for(unsigned int i=0; i<n; i++)
+		workPrev[i] = 0.0;
+}
+
+void NonlinearSolver::SetIterationBudget(unsigned int budget)
+{
+	this->budget = budget;
+}
+
+unsigned int NonlinearSolver::GetIterationBudget() const
+{
+	return budget;
+}
+
+void NonlinearSolver::SetFallback(NonlinearFallback fallback)
+{
+	this->fallback = fallback;
+}
+
+void NonlinearSolver::SetStepLimiting(bool enable)
+{
+	bLimiting = enable;
+	bLimitingSet = true;
+}
+
+void NonlinearSolver::CopySettings(const NonlinearSolver& other)
+{
+	budget = other.budget;
+	fallback = other.fallback;
+	
+	// the default of this type is kept unless the limiting is set explicitly
+	if(other.bLimitingSet)
+		SetStepLimiting(other.bLimiting);
+}
+
+const NonlinearSolverStats& NonlinearSolver::GetStats() const
+{
+	return stats;
+}
+
+void NonlinearSolver::ResetStats()
+{
+	stats.nSolves = 0;
+	stats.nIterations = 0;
+	stats.nEvaluations = 0;
+	stats.nJacobians = 0;
+	stats.nFactorizations = 0;
+	stats.nFailures = 0;
+	stats.nBudgetHits = 0;
+	stats.nFallbacks = 0;
+	stats.maxIterations = 0;
+	stats.totalGuessError = 0.0;
+}
+
+void NonlinearSolver::Reserve(unsigned int n)
+{
+	if(nWork == n)
+		return;
+	
+	nWork = n;
+	workF.resize(n);
+	workJ.resize(n * n);
+	workX.resize(n);
+	workDx.resize(n);
+	workPivots.resize(n);
+	workGuess.resize(n);
+	bValidJ = false;
+	workPrev.assign(n, 0.0);
+}
+
+void NonlinearSolver::Evaluate(NonlinearSystem& system, const double* x, double* f)
+{
+	system.Evaluate(x, f);
+	stats.nEvaluations++;
+}
+
+bool NonlinearSolver::FactorizeJacobian(NonlinearSystem& system, const double* x)
+{
+	system.GetJacobian(x, &workJ[0]);
+	stats.nJacobians++;
+	
+	return Factorize();
+}
+
+void NonlinearSolver::EvaluateWithJacobian(NonlinearSystem& system, const double* x, double* f)
+{
+	system.EvaluateWithJacobian(x, f, &workJ[0]);
+	stats.nEvaluations++;
+	stats.nJacobians++;
+	bValidJ = false;
+}
+
+bool NonlinearSolver::EvaluateAndFactorize(NonlinearSystem& system, const double* x, double* f)
+{
+	EvaluateWithJacobian(system, x, f);
+	return Factorize();
+}
+
+bool NonlinearSolver::Factorize()
+{
+	stats.nFactorizations++;
+	bValidJ = LUFactorizeInPlace(&workJ[0], nWork, &workPivots[0]);
+	return bValidJ;
+}
+
+void NonlinearSolver::SolveJacobian(double* b)
+{
+	LUSolveInPlace(&workJ[0], nWork, &workPivots[0], b);
+}
+
+bool NonlinearSolver::SolveLastJacobian(double* b)
+{
+	if(!bValidJ)
+		return false;
+	
+	SolveJacobian(b);
+	return true;
+}
+
+double NonlinearSolver::LimitStep(NonlinearSystem& system, const double* xOld, double* x)
+{
+	if(bLimiting)
+		system.LimitStep(xOld, x);
+	
+	double sum = 0.0;
+	for(unsigned int i=0; i<nWork; i++)
+		sum += (x[i] - xOld[i]) * (x[i] - xOld[i]);
+	return sqrt(sum);
+}
+
+void NonlinearSolver::ApplyFallback(NonlinearSystem& system, double* x)
+{
+	if(fallback == NonlinearFallback::NONE)
+		return;
+	
+	stats.nFallbacks++;
+	for(unsigned int i=0; i<nWork; i++)
+		x[i] = workPrev[i];
+	
+	// one Newton step from the previous solution(the system linearized at the operating point)
+	if(fallback == NonlinearFallback::LINEARIZED)
+	{
+		double* f = &workF[0];
+		if(EvaluateAndFactorize(system, x, f))
+		{
+			SolveJacobian(f);
+			for(unsigned int i=0; i<nWork; i++)
+				x[i] -= f[i];
+			LimitStep(system, &workPrev[0], x);
+			
+			// the next fallback moves on from here
+			for(unsigned int i=0; i<nWork; i++)
+				workPrev[i] = x[i];
+		}
+	}
+}
+
+//============================================================
+// full Newton
+//============================================================
+NonlinearSolver* NewtonSolver::Clone() const
+{
+	return new NewtonSolver(*this);
+}
+
+NonlinearSolverType NewtonSolver::GetType() const
+{
+	return NonlinearSolverType::NEWTON;
+}
+
+int NewtonSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	double* f = &workF[0];
+	
+	double* xOld = &workX[0];
+	
+	int iter = 0;
+	bConverged = false;
+	while(iter < max_iter)
+	{
+		// x = x - J^(-1) * F(x)
+		if(!EvaluateAndFactorize(system, x, f))
+			break;
+		SolveJacobian(f);
+		
+		for(unsigned int i=0; i<n; i++)
+		{
+			xOld[i] = x[i];
+			x[i] -= f[i];
+		}
+		iter++;
+		
+		if(LimitStep(system, xOld, x) <= epsilon)
+		{
+			bConverged = true;
+			break;
+		}
+	}
+	
+	return iter;
+}
+
+//============================================================
+// simplified Newton(chord method)
+//============================================================
+ChordSolver::ChordSolver(bool bAcrossSamples, double refreshRatio)
+{
+	this->bAcrossSamples = bAcrossSamples;
+	this->refreshRatio = refreshRatio;
+}
+
+NonlinearSolver* ChordSolver::Clone() const
+{
+	return new ChordSolver(*this);
+}
+
+NonlinearSolverType ChordSolver::GetType() const
+{
+	return NonlinearSolverType::CHORD;
+}
+
+void ChordSolver::SetAcrossSamples(bool enable)
+{
+	bAcrossSamples = enable;
+}
+
+void ChordSolver::SetRefreshRatio(double ratio)
+{
+	refreshRatio = ratio;
+}
+
+int ChordSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	double* f = &workF[0];
+	double* xOld = &workX[0];
+	
+	int iter = 0;
+	bConverged = false;
+	
+	// the Jacobian of the previous samples is kept while it converges fast, otherwise it is evaluated at the guess
+	bool bStale = bAcrossSamples && bValidJ;
+	bool bEvaluated = false;		// true if f = F(x) already
+	if(!bStale)
+	{
+		if(!EvaluateAndFactorize(system, x, f))
+			return 0;
+		bEvaluated = true;
+	}
+	
+	double prevResidual = HUGE_VAL;
+	while(iter < max_iter)
+	{
+		if(!bEvaluated)
+			Evaluate(system, x, f);
+		bEvaluated = false;
+		double residual = Norm2(f, n);
+		
+		// the convergence is slow(or diverges), so the Jacobian is too far from the current point
+		if(!(residual <= refreshRatio * prevResidual))
+		{
+			if(bStale)
+			{
+				// the step of the Jacobian of the previous samples is taken back
+				for(unsigned int i=0; i<n; i++)
+					x[i] = xOld[i];
+				residual = prevResidual;
+				bStale = false;
+				if(!EvaluateAndFactorize(system, x, f))
+					break;
+			}
+			else if(!FactorizeJacobian(system, x))
+				break;
+		}
+		prevResidual = residual;
+		
+		SolveJacobian(f);
+		for(unsigned int i=0; i<n; i++)
+		{
+			xOld[i] = x[i];
+			x[i] -= f[i];
+		}
+		iter++;
+		
+		if(LimitStep(system, xOld, x) <= epsilon)
+		{
+			bConverged = true;
+			break;
+		}
+	}
+	
+	// the Jacobian isn't kept after the failure
+	if(!bConverged)
+		bValidJ = false;
+	
+	return iter;
+}
+
+//============================================================
+// damped Newton
+//============================================================
+DampedNewtonSolver::DampedNewtonSolver(unsigned int maxHalvings)
+{
+	this->maxHalvings = maxHalvings;
+	bLimiting = true;
+}
+
+NonlinearSolver* DampedNewtonSolver::Clone() const
+{
+	return new DampedNewtonSolver(*this);
+}
+
+NonlinearSolverType DampedNewtonSolver::GetType() const
+{
+	return NonlinearSolverType::DAMPED_NEWTON;
+}
+
+int DampedNewtonSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	double* f = &workF[0];
+	double* dx = &workDx[0];
+	double* xTrial = &workX[0];
+	
+	int iter = 0;
+	bConverged = false;
+	
+	// the full step is evaluated with the Jacobian(it is accepted in most iterations), the halved ones by F(x) only
+	if(!EvaluateAndFactorize(system, x, f))
+		return 0;
+	double residual = Norm2(f, n);
+	while(iter < max_iter)
+	{
+		// the Newton step
+		for(unsigned int i=0; i<n; i++)
+			dx[i] = f[i];
+		SolveJacobian(dx);
+		iter++;
+		
+		// halve the step while the residual grows(the last one is accepted anyway), except the full step within
+		// epsilon(the residual is rounding noise there)
+		double lambda = 1.0, step = 0.0;
+		for(unsigned int k=0; ; k++)
+		{
+			for(unsigned int i=0; i<n; i++)
+				xTrial[i] = x[i] - lambda * dx[i];
+			step = LimitStep(system, x, xTrial);
+			if(k == 0)
+				EvaluateWithJacobian(system, xTrial, f);
+			else
+				Evaluate(system, xTrial, f);
+			
+			const double newResidual = Norm2(f, n);
+			if(newResidual < residual || k >= maxHalvings || (k == 0 && step <= epsilon))
+			{
+				residual = newResidual;
+				break;
+			}
+			lambda *= 0.5;
+		}
+		
+		for(unsigned int i=0; i<n; i++)
+			x[i] = xTrial[i];
+		
+		// only a full step converges(a damped one can be short while the residual is still large)
+		if(lambda == 1.0 && step <= epsilon)
+		{
+			bConverged = true;
+			break;
+		}
+		
+		// f = F(x) already, and J(x) too if the full step is accepted
+		if(iter >= max_iter)
+			break;
+		if(!(lambda == 1.0 ? Factorize() : FactorizeJacobian(system, x)))
+			break;
+	}
+	
+	return iter;
+}
+
+//============================================================
+// Broyden's method
+//============================================================
+BroydenSolver::BroydenSolver(bool bWarmStart)
+{
+	this->bWarmStart = bWarmStart;
+	bValidH = false;
+	bLimiting = true;
+}
+
+NonlinearSolver* BroydenSolver::Clone() const
+{
+	return new BroydenSolver(*this);
+}
+
+NonlinearSolverType BroydenSolver::GetType() const
+{
+	return NonlinearSolverType::BROYDEN;
+}
+
+void BroydenSolver::Prepare(NonlinearSystem& system, unsigned int n)
+{
+	NonlinearSolver::Prepare(system, n);
+	
+	H.resize(n * n);
+	f_new.resize(n);
+	Hy.resize(n);
+	dxH.resize(n);
+	bValidH = false;
+}
+
+void BroydenSolver::SetWarmStart(bool enable)
+{
+	bWarmStart = enable;
+}
+
+bool BroydenSolver::SolveLastJacobian(double* b)
+{
+	if(!bValidH || H.size() != nWork * nWork)
+		return false;
+	
+	for(unsigned int i=0; i<nWork; i++)
+		Hy[i] = b[i];
+	MatVecDynamic(&H[0], &Hy[0], b, nWork, nWork, false);
+	return true;
+}
+
+bool BroydenSolver::InvertJacobian(NonlinearSystem& system, const double* x, double* f)
+{
+	if(!(f ? EvaluateAndFactorize(system, x, f) : FactorizeJacobian(system, x)))
+		return false;
+	
+	for(unsigned int c=0; c<nWork; c++)
+	{
+		double* col = &H[c * nWork];
+		for(unsigned int r=0; r<nWork; r++)
+			col[r] = (r == c) ? 1.0 : 0.0;
+		SolveJacobian(col);
+	}
+	
+	return true;
+}
+
+int BroydenSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	if(H.size() != n * n)
+		Prepare(system, n);
+	
+	double* f = &workF[0];
+	double* fNew = &f_new[0];
+	double* dx = &workDx[0];
+	double* xOld = &workX[0];
+	
+	int iter = 0;
+	bConverged = false;
+	
+	// the inverse of the previous samples, or the inverse at the guess
+	bool bExact = !(bWarmStart && bValidH);		// true if H is the exact inverse at x
+	if(bExact)
+	{
+		if(!InvertJacobian(system, x, f))
+		{
+			bValidH = false;
+			return 0;
+		}
+	}
+	else
+		Evaluate(system, x, f);
+	bValidH = true;
+	
+	double residual = Norm2(f, n);
+	while(iter < max_iter)
+	{
+		// x = x - H * F(x)
+		MatVecDynamic(&H[0], f, dx, n, n, false);
+		for(unsigned int i=0; i<n; i++)
+		{
+			xOld[i] = x[i];
+			x[i] -= dx[i];
+		}
+		iter++;
+		
+		if(LimitStep(system, xOld, x) <= epsilon)
+		{
+			bConverged = true;
+			break;
+		}
+		for(unsigned int i=0; i<n; i++)
+			dx[i] = x[i] - xOld[i];
+		
+		Evaluate(system, x, fNew);
+		const double newResidual = Norm2(fNew, n);
+		
+		// the updated inverse is too far from the Jacobian(the residual grows), so the step is taken back
+		// and the next step is a Newton step
+		if(!bExact && !(newResidual <= residual))
+		{
+			for(unsigned int i=0; i<n; i++)
+				x[i] = xOld[i];
+			if(!InvertJacobian(system, x))
+				break;
+			bExact = true;
+			continue;
+		}
+		bExact = false;
+		
+		// H = H + (dx - H * y) * (dx^T * H) / (dx^T * H * y), y = F(x_new) - F(x)
+		for(unsigned int i=0; i<n; i++)
+			f[i] = fNew[i] - f[i];
+		MatVecDynamic(&H[0], f, &Hy[0], n, n, false);
+		
+		double denom = 0.0;
+		for(unsigned int i=0; i<n; i++)
+			denom += dx[i] * Hy[i];
+		
+		if(fabs(denom) > 1e-12 * Norm2(dx, n) * Norm2(&Hy[0], n))
+		{
+			for(unsigned int c=0; c<n; c++)
+			{
+				double sum = 0.0;
+				for(unsigned int r=0; r<n; r++)
+					sum += dx[r] * H[c * n + r];
+				dxH[c] = sum;
+			}
+			for(unsigned int c=0; c<n; c++)
+			{
+				const double scale = dxH[c] / denom;
+				for(unsigned int r=0; r<n; r++)
+					H[c * n + r] += (dx[r] - Hy[r]) * scale;
+			}
+		}
+		else
+		{
+			// the secant is degenerate
+			if(!InvertJacobian(system, x))
+				break;
+			bExact = true;
+		}
+		
+		for(unsigned int i=0; i<n; i++)
+			f[i] = fNew[i];
+		residual = newResidual;
+	}
+	
+	// the workspace may be overwritten by the fallback
+	if(!bConverged)
+		bValidH = false;
+	
+	return iter;
+}
+
+//============================================================
+// fixed-point iteration
+//============================================================
+FixedPointSolver::FixedPointSolver(double relaxation)
+{
+	this->relaxation = relaxation;
+}
+
+NonlinearSolver* FixedPointSolver::Clone() const
+{
+	return new FixedPointSolver(*this);
+}
+
+NonlinearSolverType FixedPointSolver::GetType() const
+{
+	return NonlinearSolverType::FIXED_POINT;
+}
+
+void FixedPointSolver::SetRelaxation(double relaxation)
+{
+	this->relaxation = relaxation;
+}
+
+int FixedPointSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	double* f = &workF[0];
+	
+	int iter = 0;
+	bConverged = false;
+	while(iter < max_iter)
+	{
+		Evaluate(system, x, f);
+		for(unsigned int i=0; i<n; i++)
+			x[i] += relaxation * f[i];
+		iter++;
+		
+		if(fabs(relaxation) * Norm2(f, n) <= epsilon)
+		{
+			bConverged = true;
+			break;
+		}
+	}
+	
+	return iter;
+}
+
+//============================================================
+// tabulated solution
+//============================================================
+TabulatedSolver::TabulatedSolver(double pMin, double pMax, unsigned int nPoints, bool bRefine)
+{
+	this->bRefine = bRefine;
+	bValid = false;
+	nMisses = 0;
+	SetRange(pMin, pMax, nPoints);
+}
+
+NonlinearSolver* TabulatedSolver::Clone() const
+{
+	return new TabulatedSolver(*this);
+}
+
+NonlinearSolverType TabulatedSolver::GetType() const
+{
+	return NonlinearSolverType::TABULATED;
+}
+
+void TabulatedSolver::SetRange(double pMin, double pMax, unsigned int nPoints)
+{
+	this->pMin = pMin;
+	this->pMax = pMax;
+	this->nPoints = (nPoints < 2) ? 2 : nPoints;
+	bValid = false;
+}
+
+void TabulatedSolver::Prepare(NonlinearSystem& system, unsigned int n)
+{
+	NonlinearSolver::Prepare(system, n);
+	
+	// the points are solved at the first lookup(no allocation unless the range is changed)
+	bValid = (n == 1 && system.GetParameterSize() == 1);
+	if(!bValid)
+		return;
+	
+	table.resize(nPoints);
+	states.assign(nPoints, UNSOLVED);
+}
+
+unsigned long TabulatedSolver::GetMissCount() const
+{
+	return nMisses;
+}
+
+bool TabulatedSolver::SolvePoint(NonlinearSystem& system, unsigned int k, double guess, int max_iter, double epsilon, int& iter)
+{
+	if(states[k] == CONVERGED || states[k] == FAILED)
+		return states[k] == CONVERGED;
+	if(max_iter <= 0)
+		return false;
+	
+	// continued from the last iterate, or the solution of the neighbor if there is one
+	double x = guess;
+	if(states[k] == STOPPED)
+		x = table[k];
+	else if(k > 0 && states[k - 1] == CONVERGED)
+		x = table[k - 1];
+	else if(k + 1 < nPoints && states[k + 1] == CONVERGED)
+		x = table[k + 1];
+	
+	// the iterations are done on this sample, so they are counted & bounded like the ones of a direct solve
+	double p0;
+	system.GetParameter(&p0);
+	const double p = pMin + k * (pMax - pMin) / (nPoints - 1);
+	system.SetParameter(&p);
+	bool bConverged;
+	const int nIterations = NewtonSolver::Run(system, &x, 1, max_iter, epsilon, bConverged);
+	system.SetParameter(&p0);
+	iter += nIterations;
+	
+	table[k] = x;
+	if(bConverged)
+		states[k] = CONVERGED;
+	else
+		states[k] = (nIterations < max_iter) ? FAILED : STOPPED;
+	return bConverged;
+}
+
+int TabulatedSolver::Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged)
+{
+	if(!bValid || n != 1)
+		return NewtonSolver::Run(system, x, n, max_iter, epsilon, bConverged);
+	
+	double p;
+	system.GetParameter(&p);
+	const double pos = (p - pMin) / (pMax - pMin) * (nPoints - 1);
+	if(!(pos >= 0.0 && pos <= nPoints - 1))
+	{
+		nMisses++;
+		return NewtonSolver::Run(system, x, n, max_iter, epsilon, bConverged);
+	}
+	
+	unsigned int k = (unsigned int)pos;
+	if(k >= nPoints - 1)
+		k = nPoints - 2;
+	
+	// the sample is solved directly until both points are converged, and the rest of max_iter goes to the points
+	// (the second one continues from the first one, a point stopped is continued at the next lookup)
+	if(states[k] != CONVERGED || states[k + 1] != CONVERGED)
+	{
+		nMisses++;
+		int iter = NewtonSolver::Run(system, x, n, max_iter, epsilon, bConverged);
+		if(SolvePoint(system, k, x[0], max_iter - iter, epsilon, iter))
+			SolvePoint(system, k + 1, x[0], max_iter - iter, epsilon, iter);
+		return iter;
+	}
+	
+	// linear interpolation
+	const double t = pos - k;
+	x[0] = table[k] + t * (table[k + 1] - table[k]);
+	bConverged = true;
+	
+	if(!bRefine)
+		return 0;
+	
+	// one Newton iteration
+	double* f = &workF[0];
+	if(!EvaluateAndFactorize(system, x, f))
+	{
+		bConverged = false;
+		return 1;
+	}
+	SolveJacobian(f);
+	const double xOld = x[0];
+	x[0] -= f[0];
+	bConverged = (LimitStep(system, &xOld, x) <= epsilon);
+	if(bConverged || max_iter <= 1)
+		return 1;
+	
+	// the interpolation is too far for epsilon, so Newton goes on from the refined solution
+	return 1 + NewtonSolver::Run(system, x, n, max_iter - 1, epsilon, bConverged);
+}
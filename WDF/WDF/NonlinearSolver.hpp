@@ -0,0 +1,331 @@
+//
+//  NonlinearSolver.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 27..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef NonlinearSolver_hpp
+#define NonlinearSolver_hpp
+
+#include <cstddef>
+#include <vector>
+
+//============================================================
+// the system of nonlinear equations F(x) = 0 solved by NonlinearSolver
+//============================================================
+class NonlinearSystem
+{
+public:
+	virtual ~NonlinearSystem() {}
+
+	virtual void Evaluate(const double* x, double* f) = 0;		// f = F(x)
+	virtual void GetJacobian(const double* x, double* J) = 0;	// J = dF/dx(n x n, column-major)
+	
+	// f & J at once(the terms shared by both are evaluated once), Evaluate & GetJacobian by default
+	virtual void EvaluateWithJacobian(const double* x, double* f, double* J) { Evaluate(x, f); GetJacobian(x, J); }
+
+	// the parameter of the system(F(x; p)) for the tabulated solver, none by default
+	virtual unsigned int GetParameterSize() { return 0; }
+	virtual void GetParameter(double* p) {}
+	virtual void SetParameter(const double* p) {}
+	
+	// limit the step from xOld to xNew in place(e.g. pn-junction limiting), nothing by default
+	virtual void LimitStep(const double* xOld, double* xNew) {}
+};
+
+//============================================================
+// type of the solver
+//============================================================
+enum class NonlinearSolverType
+{
+	NEWTON,				// full Newton: the Jacobian is evaluated & factorized at every iteration
+	CHORD,				// simplified Newton: the Jacobian is reused across the iterations & the samples
+	DAMPED_NEWTON,		// Newton with the step halved while the residual grows
+	BROYDEN,			// the inverse of the Jacobian is updated by rank-1 secants across the samples
+	FIXED_POINT,		// x = x + w * F(x), no Jacobian
+	TABULATED			// the solution is looked up by the parameter of the system(one-port only)
+};
+
+//============================================================
+// the solution used when the solve is not converged within the budget
+//============================================================
+enum class NonlinearFallback
+{
+	NONE,				// the last iterate
+	PREVIOUS,			// the solution of the previous solve
+	LINEARIZED			// one limited Newton step from the previous solution(the system linearized at the operating point)
+};
+
+//============================================================
+// the initial guess of the solve(selected by the owner of the solver)
+//============================================================
+enum class NonlinearPredictor
+{
+	KMETHOD,			// E * a_e + F * i_prev(the current of the previous sample through the new incident waves)
+	PREVIOUS,			// the solution of the previous sample
+	POLYNOMIAL,			// the polynomial extrapolation of the last k solutions
+	TANGENT				// x_prev - J^(-1) * (p - p_prev), the first-order change of the solution by the parameter
+};
+
+// the largest number of the solutions extrapolated by the polynomial predictor
+#define MAX_PREDICTOR_ORDER		4
+
+//============================================================
+// the statistics of the solver
+//============================================================
+struct NonlinearSolverStats
+{
+	unsigned long nSolves;			// the number of solves(samples)
+	unsigned long nIterations;		// the total number of iterations
+	unsigned long nEvaluations;		// the number of F(x) evaluated
+	unsigned long nJacobians;		// the number of Jacobians evaluated
+	unsigned long nFactorizations;	// the number of LU factorizations
+	unsigned long nFailures;		// the number of solves not converged
+	unsigned long nBudgetHits;		// the number of solves stopped by the iteration budget
+	unsigned long nFallbacks;		// the number of fallback solutions used
+	unsigned int maxIterations;		// the largest number of iterations in a solve
+	double totalGuessError;			// the sum of |x - guess| of the solves(the error of the predictor)
+
+	double GetAvgIterations() const { return nSolves ? (double)nIterations / nSolves : 0.0; }
+	double GetAvgGuessError() const { return nSolves ? totalGuessError / nSolves : 0.0; }
+};
+
+//============================================================
+// base class of the solvers
+// The workspace is reserved by the size of the system, so Solve doesn't allocate once it is prepared.
+//============================================================
+class NonlinearSolver
+{
+public:
+	NonlinearSolver();
+	virtual ~NonlinearSolver();
+	virtual NonlinearSolver* Clone() const = 0;
+	virtual NonlinearSolverType GetType() const = 0;
+
+	// create the solver of the type
+	static NonlinearSolver* Create(NonlinearSolverType type);
+
+	// solve F(x) = 0 in place from the guess x, then return the number of iterations
+	int Solve(NonlinearSystem& system, double* x, unsigned int n, int max_iter=100, double epsilon=1e-9);
+
+	// called when the system is changed(the workspace is reserved, and the state of the solver is discarded)
+	virtual void Prepare(NonlinearSystem& system, unsigned int n);
+	
+	// the maximum number of iterations in a solve regardless of max_iter(0: max_iter only)
+	void SetIterationBudget(unsigned int budget);
+	unsigned int GetIterationBudget() const;
+	
+	// the solution used when the solve is not converged
+	void SetFallback(NonlinearFallback fallback);
+	
+	// limit each step by NonlinearSystem::LimitStep(pn-junction limiting)
+	void SetStepLimiting(bool enable);
+	
+	// copy the budget, the fallback & the step limiting set to the other solver(when the solver is replaced)
+	void CopySettings(const NonlinearSolver& other);
+	
+	// b = J^(-1) * b by the Jacobian(or its approximation) of the last solve, false if there is none(the tangent predictor)
+	virtual bool SolveLastJacobian(double* b);
+
+	const NonlinearSolverStats& GetStats() const;
+	void ResetStats();
+
+protected:
+	// iterate until converged, then return the number of iterations(bConverged: false if not converged)
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged) = 0;
+
+	void Reserve(unsigned int n);
+	void Evaluate(NonlinearSystem& system, const double* x, double* f);	// counted F(x)
+	bool FactorizeJacobian(NonlinearSystem& system, const double* x);		// workJ = LU of J(x)
+	void EvaluateWithJacobian(NonlinearSystem& system, const double* x, double* f);	// counted F(x) & workJ = J(x)(not factorized)
+	bool EvaluateAndFactorize(NonlinearSystem& system, const double* x, double* f);	// counted F(x) & workJ = LU of J(x)
+	bool Factorize();														// workJ = LU of workJ
+	void SolveJacobian(double* b);											// b = J^(-1) * b
+	double LimitStep(NonlinearSystem& system, const double* xOld, double* x);	// limit if enabled, then return the norm of the step
+	void ApplyFallback(NonlinearSystem& system, double* x);
+
+	NonlinearSolverStats stats;
+	unsigned int nWork;						// the size of the workspace
+	std::vector<double> workF, workJ, workX, workDx, workGuess;
+	std::vector<unsigned int> workPivots;
+	bool bValidJ;							// true if workJ is the factorized Jacobian of the system
+	
+	unsigned int budget;					// the iteration budget(0: none)
+	NonlinearFallback fallback;
+	bool bLimiting;							// true if the steps are limited
+	bool bLimitingSet;						// true if bLimiting is set by SetStepLimiting(not the default of the type)
+	std::vector<double> workPrev;			// the solution of the previous solve(zero when prepared)
+};
+
+//============================================================
+// full Newton
+//============================================================
+class NewtonSolver : public NonlinearSolver
+{
+public:
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+};
+
+//============================================================
+// simplified Newton(chord method)
+// The factorized Jacobian is kept across the iterations, and across the samples while the operating point moves little.
+// It is refreshed only when the convergence slows(the step isn't reduced by the ratio).
+//============================================================
+class ChordSolver : public NonlinearSolver
+{
+public:
+	ChordSolver(bool bAcrossSamples=true, double refreshRatio=0.25);
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+	
+	void SetAcrossSamples(bool enable);		// false: the Jacobian is evaluated at the guess of every sample
+	void SetRefreshRatio(double ratio);		// the Jacobian is refreshed if |dx| > ratio * |dx_prev|
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+	
+	bool bAcrossSamples;
+	double refreshRatio;
+};
+
+//============================================================
+// damped Newton(backtracking on the residual)
+//============================================================
+class DampedNewtonSolver : public NonlinearSolver
+{
+public:
+	DampedNewtonSolver(unsigned int maxHalvings=4);
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+
+	unsigned int maxHalvings;		// the number of times the step can be halved in an iteration
+};
+
+//============================================================
+// Broyden's method
+// The inverse of the Jacobian is updated by Sherman-Morrison(O(n^2) per iteration, no factorization), and it is
+// warm-started from the previous sample. A step growing the residual is taken back and replaced by a Newton step,
+// so the Jacobian is evaluated only when the secants drift. The steps are limited by default.
+//============================================================
+class BroydenSolver : public NonlinearSolver
+{
+public:
+	BroydenSolver(bool bWarmStart=true);
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+	
+	virtual void Prepare(NonlinearSystem& system, unsigned int n);
+	
+	void SetWarmStart(bool enable);		// false: the inverse is evaluated at the guess of every sample
+	
+	virtual bool SolveLastJacobian(double* b);	// b = H * b
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+	
+	bool InvertJacobian(NonlinearSystem& system, const double* x, double* f=NULL);	// H = J(x)^(-1)(& f = F(x) if given)
+	
+	bool bWarmStart;
+	bool bValidH;					// true if H is the inverse of the system
+	std::vector<double> H;			// the approximated inverse of the Jacobian(column-major)
+	std::vector<double> f_new, Hy, dxH;
+};
+
+//============================================================
+// fixed-point iteration: x = x + w * F(x)
+// It converges if the loop gain of the system is less than 1(e.g. the K-method with small port resistances).
+//============================================================
+class FixedPointSolver : public NonlinearSolver
+{
+public:
+	FixedPointSolver(double relaxation=1.0);
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+
+	void SetRelaxation(double relaxation);
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+
+	double relaxation;				// w
+};
+
+//============================================================
+// tabulated solution of the one-port system F(x; p) = 0
+// The solution is interpolated from the solutions at the points of p, then refined by one Newton iteration
+// (Newton goes on if the refined step is still above epsilon). The points are solved by Newton at their lookups,
+// so preparing only invalidates the table: until both points are converged, the sample is solved directly, then the
+// iterations left in max_iter(and the budget) go to the points, and a point stopped by them is continued at the next
+// lookup. So the iterations of the points are counted as the ones of the sample. Newton is used outside of the table
+// and around the points failed.
+//============================================================
+class TabulatedSolver : public NewtonSolver
+{
+public:
+	TabulatedSolver(double pMin=-10.0, double pMax=10.0, unsigned int nPoints=1024, bool bRefine=true);
+	virtual NonlinearSolver* Clone() const;
+	virtual NonlinearSolverType GetType() const;
+
+	// set the range of the table(applied when prepared)
+	void SetRange(double pMin, double pMax, unsigned int nPoints);
+
+	virtual void Prepare(NonlinearSystem& system, unsigned int n);
+
+	unsigned long GetMissCount() const;		// the number of solves not by the table(outside, or the points not converged)
+
+protected:
+	virtual int Run(NonlinearSystem& system, double* x, unsigned int n, int max_iter, double epsilon, bool& bConverged);
+	
+	// the state of a point of the table
+	enum PointState { UNSOLVED, CONVERGED, FAILED, STOPPED };	// STOPPED: by max_iter, continued from its last iterate
+	
+	// solve the point k if unsolved within max_iter iterations(added to iter), then return true if converged
+	bool SolvePoint(NonlinearSystem& system, unsigned int k, double guess, int max_iter, double epsilon, int& iter);
+
+	double pMin, pMax;
+	unsigned int nPoints;
+	bool bRefine;					// one Newton iteration after the interpolation
+	bool bValid;					// true if the table is for the system
+	std::vector<double> table;		// the solutions at p = pMin + k * dp
+	std::vector<unsigned char> states;	// PointState of the points
+	unsigned long nMisses;
+};
+
+//============================================================
+// the owner of a solver(the solver is cloned when copied)
+//============================================================
+class NonlinearSolverPtr
+{
+public:
+	NonlinearSolverPtr(NonlinearSolver* solver=NULL) : solver(solver) {}
+	NonlinearSolverPtr(const NonlinearSolverPtr& other) : solver(other.solver ? other.solver->Clone() : NULL) {}
+	~NonlinearSolverPtr() { delete solver; }
+
+	NonlinearSolverPtr& operator=(const NonlinearSolverPtr& other)
+	{
+		if(this != &other)
+		{
+			delete solver;
+			solver = other.solver ? other.solver->Clone() : NULL;
+		}
+		return *this;
+	}
+
+	void Reset(NonlinearSolver* solver) { delete this->solver; this->solver = solver; }
+	NonlinearSolver* Get() const { return solver; }
+	NonlinearSolver* operator->() const { return solver; }
+
+private:
+	NonlinearSolver* solver;
+};
+
+#endif /* NonlinearSolver_hpp */
@@ -0,0 +1,242 @@
+//
+//  Oversampler.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 14..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <cmath>
+#include "Oversampler.hpp"
+
+/**
+ the zeroth order modified Bessel function of the first kind(for Kaiser window)
+ */
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for(int k=1; k<50; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if(term < sum * 1e-16)
+			break;
+	}
+	return sum;
+}
+
+/**
+ The fallback for any number of taps
+ */
+static inline float DotDynamic(const float* h, const float* x, float x0, unsigned int n)
+{
+	float y = h[0] * x0;
+	for(unsigned int j=1; j<n; j++)
+		y += h[j] * x[j];
+	return y;
+}
+
+/**
+ The inner product for the number of taps known at compile time. It is accumulated in 4 independent partial sums, so the loop is unrolled and mapped to SIMD lanes without reassociating the float additions.
+ x[0] has just been pushed, so it is given by x0: a vector load over the fresh store would stall on the store forwarding.
+ */
+template<unsigned int N>
+static inline float DotFixed(const float* h, const float* x, float x0)
+{
+	static_assert(N % 4 == 0, "the number of taps should be a multiple of 4");
+
+	float sum[4] = { h[0] * x0, h[1] * x[1], h[2] * x[2], h[3] * x[3] };
+	for(unsigned int j=4; j<N; j+=4)
+		for(unsigned int k=0; k<4; k++)
+			sum[k] += h[j + k] * x[j + k];
+
+	return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+}
+
+/**
+ h[0] * x0 + h[1] * x[1] + ... + h[n-1] * x[n-1], the inner product of the polyphase branch(the lengths of the stages of Oversampler are unrolled)
+ */
+static inline float Dot(const float* h, const float* x, float x0, unsigned int n)
+{
+	switch(n)
+	{
+		case 8:		return DotFixed<8>(h, x, x0);
+		case 12:	return DotFixed<12>(h, x, x0);
+		case 32:	return DotFixed<32>(h, x, x0);
+		default:	return DotDynamic(h, x, x0, n);
+	}
+}
+
+//============================================================
+// Half-band filter
+//============================================================
+HalfBandFilter::HalfBandFilter(unsigned int nTaps, double beta)
+{
+	this->nTaps = nTaps;
+	pos = 0;
+
+	coefs.resize(nTaps);
+	delay.resize(nTaps * 2);
+	centerDelay.resize(nTaps * 2);
+
+	//============================================================
+	// windowed sinc: h[k] = 0.5 * sinc((k - c) / 2) * w[k]
+	// the length is 2 * nTaps - 1, and the center(c) is nTaps - 1.
+	// only the taps at odd distance from the center(even k) are nonzero.
+	//============================================================
+	const double c = nTaps - 1.0;
+	double sum = 0.0;
+	for(unsigned int j=0; j<nTaps; j++)
+	{
+		double t = 2.0 * j - c;
+		double sinc = sin(M_PI * t / 2.0) / (M_PI * t / 2.0);
+		double r = t / (c + 1.0);
+		double window = BesselI0(beta * sqrt(1.0 - r * r)) / BesselI0(beta);
+		coefs[j] = 0.5 * sinc * window;
+		sum += coefs[j];
+	}
+
+	// normalize: the sum of the nonzero taps is 0.5 except the center(0.5), so DC gain is 1
+	for(unsigned int j=0; j<nTaps; j++)
+		coefs[j] = coefs[j] * 0.5 / sum;
+}
+
+HalfBandFilter::~HalfBandFilter()
+{
+
+}
+
+const float* HalfBandFilter::Push(vector<float> &buffer, float x)
+{
+	// store twice, then the window is always contiguous
+	buffer[pos] = x;
+	buffer[pos + nTaps] = x;
+	return &buffer[pos];
+}
+
+void HalfBandFilter::Interpolate(float x, float* out)
+{
+	pos = (pos == 0) ? nTaps - 1 : pos - 1;
+	const float* p = Push(delay, x);
+
+	// even phase: the filtered branch
+	out[0] = 2.0f * Dot(&coefs[0], p, x, nTaps);
+
+	// odd phase: the center tap only(2 * 0.5)
+	out[1] = p[nTaps/2 - 1];
+}
+
+float HalfBandFilter::Decimate(const float* in)
+{
+	pos = (pos == 0) ? nTaps - 1 : pos - 1;
+	const float* pe = Push(centerDelay, in[0]);
+	const float* po = Push(delay, in[1]);
+
+	// filtered branch(odd samples) + center tap(even samples)
+	return Dot(&coefs[0], po, in[1], nTaps) + 0.5f * pe[nTaps/2 - 1];
+}
+
+void HalfBandFilter::Clear()
+{
+	for(unsigned int i=0; i<delay.size(); i++)
+	{
+		delay[i] = 0.0f;
+		centerDelay[i] = 0.0f;
+	}
+	pos = 0;
+}
+
+//============================================================
+// Oversampler
+//============================================================
+Oversampler::Oversampler(unsigned int factor)
+{
+	// the first stage has the narrowest transition band, the followings can be shorter
+	const unsigned int taps[3] = { 32, 12, 8 };
+	const double betas[3] = { 8.0, 7.0, 6.0 };
+
+	unsigned int iStage = 0;
+	for(unsigned int f = MAX_OVERSAMPLING; f > 1; f /= 2, iStage++)
+	{
+		upStages.push_back(new HalfBandFilter(taps[iStage], betas[iStage]));
+		downStages.push_back(new HalfBandFilter(taps[iStage], betas[iStage]));
+	}
+
+	this->factor = 1;
+	nStages = 0;
+	SetFactor(factor);
+}
+
+Oversampler::~Oversampler()
+{
+	for(vector<HalfBandFilter*>::iterator iter = upStages.begin(); iter != upStages.end(); iter++)
+		delete *iter;
+	for(vector<HalfBandFilter*>::iterator iter = downStages.begin(); iter != downStages.end(); iter++)
+		delete *iter;
+}
+
+bool Oversampler::SetFactor(unsigned int factor)
+{
+	if(factor != 1 && factor != 2 && factor != 4 && factor != 8)
+		return false;
+
+	unsigned int n = 0;
+	for(unsigned int f = factor; f > 1; f /= 2)
+		n++;
+
+	// the stages which were idle have old samples
+	for(unsigned int i=nStages; i<n; i++)
+	{
+		upStages[i]->Clear();
+		downStages[i]->Clear();
+	}
+
+	this->factor = factor;
+	nStages = n;
+	return true;
+}
+
+unsigned int Oversampler::GetFactor()
+{
+	return factor;
+}
+
+void Oversampler::Upsample(float x, float* out)
+{
+	float temp[MAX_OVERSAMPLING];
+	out[0] = x;
+
+	// base rate -> internal rate
+	unsigned int n = 1;
+	for(vector<HalfBandFilter*>::iterator iter = upStages.begin(); iter != upStages.begin() + nStages; iter++)
+	{
+		for(unsigned int i=0; i<n; i++)
+			temp[i] = out[i];
+		for(unsigned int i=0; i<n; i++)
+			(*iter)->Interpolate(temp[i], &out[2*i]);
+		n *= 2;
+	}
+}
+
+float Oversampler::Downsample(float* in)
+{
+	// internal rate -> base rate, in place
+	unsigned int n = factor;
+	for(vector<HalfBandFilter*>::reverse_iterator iter = downStages.rend() - nStages; iter != downStages.rend(); iter++)
+	{
+		n /= 2;
+		for(unsigned int i=0; i<n; i++)
+			in[i] = (*iter)->Decimate(&in[2*i]);
+	}
+
+	return in[0];
+}
+
+void Oversampler::Clear()
+{
+	for(unsigned int i=0; i<upStages.size(); i++)
+	{
+		upStages[i]->Clear();
+		downStages[i]->Clear();
+	}
+}
@@ -0,0 +1,165 @@
+//
+//  Oversampler.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 14..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef Oversampler_hpp
+#define Oversampler_hpp
+
+#include <vector>
+
+using namespace std;
+
+/**
+ the maximum oversampling factor
+ */
+#define MAX_OVERSAMPLING	8
+
+/**
+ A class of half-band FIR filter which changes the sampling rate by two. It's implemented as polyphase, so only the nonzero taps are calculated at the low rate. An instance keeps the state of one direction, so use separate instances for up & down sampling.
+ */
+class HalfBandFilter
+{
+public:
+	/**
+	 Create a half-band filter
+
+	 @param nTaps the number of nonzero taps except the center tap. It should be even.
+	 @param beta the parameter of the Kaiser window
+	 */
+	HalfBandFilter(unsigned int nTaps, double beta);
+	~HalfBandFilter();
+
+	/**
+	 Upsample a sample by two
+
+	 @param x an input sample at the low rate
+	 @param out two output samples at the high rate
+	 */
+	void Interpolate(float x, float* out);
+
+	/**
+	 Downsample two samples by two
+
+	 @param in two input samples at the high rate
+	 @return an output sample at the low rate
+	 */
+	float Decimate(const float* in);
+
+	/**
+	 Clear the delay lines
+	 */
+	void Clear();
+
+protected:
+	/**
+	 Push a sample to the doubled circular buffer
+
+	 @param buffer the buffer whose size is 2 * nTaps
+	 @param x the sample to be pushed
+	 @return the pointer to the newest sample. The older samples follow it contiguously.
+	 */
+	const float* Push(vector<float> &buffer, float x);
+
+	/**
+	 the nonzero taps except the center tap: h[0], h[2], h[4], ...
+	 */
+	vector<float> coefs;
+
+	/**
+	 the delay line of the filtered branch
+	 */
+	vector<float> delay;
+
+	/**
+	 the delay line of the branch which has the center tap only(used in decimation)
+	 */
+	vector<float> centerDelay;
+
+	/**
+	 the number of nonzero taps except the center tap
+	 */
+	unsigned int nTaps;
+
+	/**
+	 the current position of the circular buffer
+	 */
+	unsigned int pos;
+};
+
+/**
+ A class that changes the sampling rate by 2, 4 or 8 using the cascade of half-band filters. The stages of the highest factor are created once, and a lower factor uses only the first stages, so changing the factor doesn't allocate.
+ */
+class Oversampler
+{
+public:
+	/**
+	 Create an oversampler
+
+	 @param factor the oversampling factor(1, 2, 4 or 8)
+	 */
+	Oversampler(unsigned int factor=1);
+	~Oversampler();
+
+	/**
+	 Set the oversampling factor. It doesn't allocate: the stages kept in use keep their delay lines, and the stages newly used are cleared.
+
+	 @param factor the oversampling factor(1, 2, 4 or 8)
+	 @return false if the factor is not supported
+	 */
+	bool SetFactor(unsigned int factor);
+
+	/**
+	 Get the oversampling factor
+
+	 @return the oversampling factor
+	 */
+	unsigned int GetFactor();
+
+	/**
+	 Upsample a sample
+
+	 @param x an input sample at the base rate
+	 @param out the output samples at the internal rate. The size is same as the factor.
+	 */
+	void Upsample(float x, float* out);
+
+	/**
+	 Downsample the samples. The input array is used as working memory.
+
+	 @param in the input samples at the internal rate. The size is same as the factor.
+	 @return an output sample at the base rate
+	 */
+	float Downsample(float* in);
+
+	/**
+	 Clear all delay lines
+	 */
+	void Clear();
+
+protected:
+	/**
+	 the oversampling factor
+	 */
+	unsigned int factor;
+
+	/**
+	 the number of stages in use(log2 of the factor)
+	 */
+	unsigned int nStages;
+
+	/**
+	 the stages of upsampling: from the base rate to the internal rate(for MAX_OVERSAMPLING)
+	 */
+	vector<HalfBandFilter*> upStages;
+
+	/**
+	 the stages of downsampling: from the internal rate to the base rate(for MAX_OVERSAMPLING)
+	 */
+	vector<HalfBandFilter*> downStages;
+};
+
+#endif /* Oversampler_hpp */
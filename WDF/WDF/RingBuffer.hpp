@@ -0,0 +1,240 @@
+//
+//  RingBuffer.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 21..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef RingBuffer_hpp
+#define RingBuffer_hpp
+
+#include <atomic>
+#include <vector>
+
+/**
+ A lock-free ring buffer for a single producer and a single consumer. Push is called only by the producer thread, and Pop only by the consumer thread. The items are moved as a whole, so a block is never split.
+ */
+template<typename T>
+class RingBuffer
+{
+public:
+	/**
+	 Create a ring buffer
+	 
+	 @param capacity the maximum number of items stored
+	 */
+	RingBuffer(unsigned int capacity) : buffer(capacity + 1), head(0), tail(0) {}
+	
+	/**
+	 Push the items(producer only)
+	 
+	 @param items the items to be pushed
+	 @param n the number of items
+	 @return false if there is not enough space. Nothing is pushed in that case.
+	 */
+	bool Push(const T* items, unsigned int n)
+	{
+		const unsigned int size = (unsigned int)buffer.size();
+		const unsigned int t = tail.load(std::memory_order_relaxed);
+		const unsigned int h = head.load(std::memory_order_acquire);
+		const unsigned int used = (t >= h) ? t - h : t + size - h;
+		if(used + n > size - 1)
+			return false;
+		
+		unsigned int pos = t;
+		for(unsigned int i=0; i<n; i++)
+		{
+			buffer[pos] = items[i];
+			if(++pos == size)
+				pos = 0;
+		}
+		
+		// publish the items
+		tail.store(pos, std::memory_order_release);
+		return true;
+	}
+	
+	/**
+	 Pop the items(consumer only)
+	 
+	 @param items the array to which the items are copied
+	 @param n the number of items
+	 @return false if there are not enough items. Nothing is popped in that case.
+	 */
+	bool Pop(T* items, unsigned int n)
+	{
+		const unsigned int size = (unsigned int)buffer.size();
+		const unsigned int h = head.load(std::memory_order_relaxed);
+		const unsigned int t = tail.load(std::memory_order_acquire);
+		const unsigned int used = (t >= h) ? t - h : t + size - h;
+		if(used < n)
+			return false;
+		
+		unsigned int pos = h;
+		for(unsigned int i=0; i<n; i++)
+		{
+			items[i] = buffer[pos];
+			if(++pos == size)
+				pos = 0;
+		}
+		
+		// release the space
+		head.store(pos, std::memory_order_release);
+		return true;
+	}
+	
+	/**
+	 Get the number of items stored. It's exact only when called by the producer or the consumer.
+	 
+	 @return the number of items
+	 */
+	unsigned int GetCount() const
+	{
+		const unsigned int size = (unsigned int)buffer.size();
+		const unsigned int h = head.load(std::memory_order_acquire);
+		const unsigned int t = tail.load(std::memory_order_acquire);
+		return (t >= h) ? t - h : t + size - h;
+	}
+	
+private:
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+	
+	/**
+	 the storage. One slot is always empty to distinguish full from empty.
+	 */
+	std::vector<T> buffer;
+	
+	/**
+	 the position to be read next(written by the consumer)
+	 */
+	std::atomic<unsigned int> head;
+	
+	/**
+	 the position to be written next(written by the producer)
+	 */
+	std::atomic<unsigned int> tail;
+};
+
+/**
+ A lock-free bounded queue for multiple producers and a single consumer. Each slot has a sequence number, so a producer claims a slot by a single compare-and-swap and never waits for the other producers. Pop is called only by the consumer thread. The capacity is rounded up to a power of two.
+ */
+template<typename T>
+class MPSCRingBuffer
+{
+public:
+	/**
+	 Create a queue
+	 
+	 @param capacity the maximum number of items stored
+	 */
+	MPSCRingBuffer(unsigned int capacity) : enqueuePos(0), dequeuePos(0)
+	{
+		unsigned int size = 2;
+		while(size < capacity)
+			size *= 2;
+		
+		cells = new Cell[size];
+		mask = size - 1;
+		for(unsigned int i=0; i<size; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	
+	~MPSCRingBuffer()
+	{
+		delete [] cells;
+	}
+	
+	/**
+	 Push an item(any thread)
+	 
+	 @param item the item to be pushed
+	 @return false if the queue is full
+	 */
+	bool Push(const T &item)
+	{
+		Cell* cell;
+		unsigned int pos = enqueuePos.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			cell = &cells[pos & mask];
+			const unsigned int seq = cell->sequence.load(std::memory_order_acquire);
+			const int diff = (int)(seq - pos);
+			if(diff == 0)
+			{
+				// the slot is free, claim it
+				if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if(diff < 0)
+			{
+				// the consumer hasn't released the slot yet
+				return false;
+			}
+			else
+			{
+				// another producer has claimed it
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+		
+		// publish the item
+		cell->data = item;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+	
+	/**
+	 Pop an item(consumer only)
+	 
+	 @param item the item popped
+	 @return false if the queue is empty(or the oldest item is being written)
+	 */
+	bool Pop(T &item)
+	{
+		Cell* cell = &cells[dequeuePos & mask];
+		const unsigned int seq = cell->sequence.load(std::memory_order_acquire);
+		if((int)(seq - (dequeuePos + 1)) < 0)
+			return false;
+		
+		item = cell->data;
+		
+		// release the slot for the next round
+		cell->sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+		dequeuePos++;
+		return true;
+	}
+	
+private:
+	MPSCRingBuffer(const MPSCRingBuffer&);
+	MPSCRingBuffer& operator=(const MPSCRingBuffer&);
+	
+	struct Cell
+	{
+		std::atomic<unsigned int> sequence;	// pos: free, pos + 1: filled
+		T data;
+	};
+	
+	/**
+	 the slots
+	 */
+	Cell* cells;
+	
+	/**
+	 the size of the slots - 1
+	 */
+	unsigned int mask;
+	
+	/**
+	 the position to be claimed next by a producer
+	 */
+	std::atomic<unsigned int> enqueuePos;
+	
+	/**
+	 the position to be read next(used by the consumer only)
+	 */
+	unsigned int dequeuePos;
+};
+
+#endif /* RingBuffer_hpp */
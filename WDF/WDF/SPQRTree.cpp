@@ -7,6 +7,7 @@
 //
 
 #include "SPQRTree.hpp"
+#include <atomic>
 
 typedef vector<SPQRTreeElement*>	ElementVector;
 typedef vector<SPQRTreeLeaf*>		LeafVector;
@@ -14,7 +15,7 @@ typedef vector<SPQRTreeLeaf*>		LeafVector;
 /**
  the index of node. It's used as id.
  */
-unsigned int g_uiNodeIndex = 0;
+atomic<unsigned int> g_uiNodeIndex(0);
 
 SPQRTree::SPQRTree()
 {
@@ -895,10 +896,12 @@ void SPQRTree::SetInputFrequency(float fInputFrequency)
 	this->fInputFrequency = fInputFrequency;
 }
 
-WDFTree* SPQRTree::CreateWDFTree(float fSamplingTime)
+WDFTree* SPQRTree::CreateWDFTree(float fSamplingTime, unsigned int nOversampling, WDFEngine engine)
 {
 	WDFTree* wdfTree = new WDFTree(fSamplingTime, fInputVoltage, fInputFrequency);
+	wdfTree->SetOversampling(nOversampling);
 	GetRoot()->CreateWDFObject(wdfTree);
+	wdfTree->SetEngine(engine);
 	
 	return wdfTree;
 }
@@ -224,9 +224,11 @@ public:
 	 Create the WDF tree
 
 	 @param fSamplingTime sampling period
+	 @param nOversampling oversampling factor(1, 2, 4 or 8). The reactive elements are created at the internal rate.
+	 @param engine the engine of the tree. If the circuit is nonlinear, the wave engine is used.
 	 @return a new tree
 	 */
-	WDFTree* CreateWDFTree(float fSamplingTime);
+	WDFTree* CreateWDFTree(float fSamplingTime, unsigned int nOversampling=1, WDFEngine engine=WDFEngine::WAVE);
 	
 protected:
 	/**
@@ -610,7 +610,7 @@ void SPQRTreeLeaf::CreateWDFObject(WDFTree* wdfTree)
 	}
 	else if(prefix == "C")		// capacitor
 	{
-		WDFCapacitor* capacitor = new WDFCapacitor(values[VAL_CAPACITANCE], wdfTree->GetSamplingTime(), id);
+		WDFCapacitor* capacitor = new WDFCapacitor(values[VAL_CAPACITANCE], wdfTree->GetInternalSamplingTime(), id);
 		wdfTree->AddObject(capacitor);
 		if(options[OPT_OUTPUT])
 			wdfTree->SetOutput(capacitor);
@@ -625,7 +625,7 @@ void SPQRTreeLeaf::CreateWDFObject(WDFTree* wdfTree)
 	}
 	else if(prefix == "I")		// inductor
 	{
-		WDFInductor* inductor = new WDFInductor(values[VAL_INDUCTANCE], wdfTree->GetSamplingTime(), id);
+		WDFInductor* inductor = new WDFInductor(values[VAL_INDUCTANCE], wdfTree->GetInternalSamplingTime(), id);
 		wdfTree->AddObject(inductor);
 		if(options[OPT_OUTPUT])
 			wdfTree->SetOutput(inductor);
@@ -0,0 +1,98 @@
+//
+//  Semaphore.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 31..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef Semaphore_hpp
+#define Semaphore_hpp
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+/**
+ A counting semaphore of the platform. Post doesn't lock anything, and it makes a system call only to wake a waiting thread(a futex wake on Linux), so it can be called on the audio thread.
+ */
+class Semaphore
+{
+public:
+	/**
+	 Create a semaphore with no count
+	 */
+	Semaphore()
+	{
+#if defined(__APPLE__)
+		semaphore = dispatch_semaphore_create(0);
+#elif defined(_WIN32)
+		semaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+#else
+		sem_init(&semaphore, 0, 0);
+#endif
+	}
+
+	~Semaphore()
+	{
+#if defined(__APPLE__)
+		dispatch_release(semaphore);
+#elif defined(_WIN32)
+		CloseHandle(semaphore);
+#else
+		sem_destroy(&semaphore);
+#endif
+	}
+
+	/**
+	 Increase the count, then wake the waiting threads
+
+	 @param count the number of threads to be woken
+	 */
+	void Post(unsigned int count=1)
+	{
+#if defined(__APPLE__)
+		for(unsigned int i=0; i<count; i++)
+			dispatch_semaphore_signal(semaphore);
+#elif defined(_WIN32)
+		ReleaseSemaphore(semaphore, (LONG)count, NULL);
+#else
+		for(unsigned int i=0; i<count; i++)
+			sem_post(&semaphore);
+#endif
+	}
+
+	/**
+	 Sleep until the count is positive, then decrease it
+	 */
+	void Wait()
+	{
+#if defined(__APPLE__)
+		dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+#elif defined(_WIN32)
+		WaitForSingleObject(semaphore, INFINITE);
+#else
+		while(sem_wait(&semaphore) != 0 && errno == EINTR)
+			;
+#endif
+	}
+
+private:
+	Semaphore(const Semaphore&);
+	Semaphore& operator=(const Semaphore&);
+
+#if defined(__APPLE__)
+	dispatch_semaphore_t semaphore;
+#elif defined(_WIN32)
+	HANDLE semaphore;
+#else
+	sem_t semaphore;
+#endif
+};
+
+#endif /* Semaphore_hpp */
@@ -0,0 +1,117 @@
+//
+//  SpinWait.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 30..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef SpinWait_hpp
+#define SpinWait_hpp
+
+#include <atomic>
+#include <chrono>
+#include "Semaphore.hpp"
+
+/**
+ A wait of a thread for a condition of atomic variables(e.g. a queue is not empty). The waiter spins a short time, then sleeps on a semaphore, so an idle thread doesn't burn a core. The notifier never locks: it checks the flag of the sleeper, and posts the semaphore only if the waiter sleeps.
+ 
+ Only one thread waits on a wait at a time. A thread which must not block(e.g. audio thread) only notifies, or polls by SpinUntil.
+ 
+ The condition must be changed by the atomic operations before Notify is called.
+ */
+class SpinWait
+{
+public:
+	/**
+	 Create a wait
+	 
+	 @param nSpins the number of checks before sleeping
+	 */
+	SpinWait(unsigned int nSpins=2000) : nSpins(nSpins), bSleeping(false) {}
+	
+	/**
+	 Wait until the condition is true
+	 
+	 @param ready the condition
+	 */
+	template<typename Condition>
+	void Wait(Condition ready)
+	{
+		while(!Spin(ready))
+		{
+			// either the notifier sees the flag, or this sees the condition
+			bSleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(ready())
+			{
+				// a notifier which has taken the flag posts, and the post is consumed
+				if(!bSleeping.exchange(false))
+					semaphore.Wait();
+				return;
+			}
+			
+			semaphore.Wait();
+		}
+	}
+	
+	/**
+	 Wake the waiting thread after the condition is changed. It doesn't lock or wait.
+	 */
+	void Notify()
+	{
+		// pairs with the fence of the waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(!bSleeping.load(std::memory_order_relaxed))
+			return;
+		
+		// only the notifier which takes the flag posts
+		if(bSleeping.exchange(false))
+			semaphore.Post();
+	}
+	
+	/**
+	 Poll the condition until it's true or the deadline, without sleeping(for the thread which must not block)
+	 
+	 @param ready the condition
+	 @param deadline the time to give up
+	 @return false if the deadline has passed
+	 */
+	template<typename Condition>
+	static bool SpinUntil(Condition ready, std::chrono::steady_clock::time_point deadline)
+	{
+		for(unsigned int i=0; ; i++)
+		{
+			if(ready())
+				return true;
+			
+			// the clock is read once in a while
+			if((i & 63) == 63 && std::chrono::steady_clock::now() >= deadline)
+				return ready();
+		}
+	}
+	
+private:
+	SpinWait(const SpinWait&);
+	SpinWait& operator=(const SpinWait&);
+	
+	/**
+	 Check the condition nSpins times
+	 
+	 @return true if the condition is true
+	 */
+	template<typename Condition>
+	bool Spin(Condition ready)
+	{
+		for(unsigned int i=0; i<nSpins; i++)
+			if(ready())
+				return true;
+		return false;
+	}
+	
+	unsigned int nSpins;
+	std::atomic<bool> bSleeping;	// true while the waiter sleeps(or is about to)
+	Semaphore semaphore;
+};
+
+#endif /* SpinWait_hpp */
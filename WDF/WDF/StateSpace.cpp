@@ -0,0 +1,100 @@
+//
+//  StateSpace.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 16..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <cmath>
+#include "StateSpace.hpp"
+
+StateSpace::StateSpace()
+{
+	Resize(0);
+}
+
+StateSpace::~StateSpace()
+{
+	
+}
+
+void StateSpace::Resize(unsigned int nStates, unsigned int nSources)
+{
+	this->nStates = nStates;
+	this->nSources = nSources;
+	
+	A.assign(nStates * nStates, 0.0);
+	B.assign(nStates, 0.0);
+	C.assign(nStates, 0.0);
+	c.assign(nStates, 0.0);
+	D = 0.0;
+	d = 0.0;
+	E.assign(nStates * nSources, 0.0);
+	F.assign(nSources, 0.0);
+	
+	x.assign(nStates, 0.0);
+	xNext.assign(nStates, 0.0);
+	maxChange = 0.0;
+}
+
+unsigned int StateSpace::GetStateCount()
+{
+	return nStates;
+}
+
+unsigned int StateSpace::GetSourceCount()
+{
+	return nSources;
+}
+
+void StateSpace::ChangeSource(unsigned int k, double delta)
+{
+	if(k >= nSources)
+		return;
+	
+	const double* col = nStates ? &E[k * nStates] : NULL;
+	for(unsigned int i=0; i<nStates; i++)
+		c[i] += delta * col[i];
+	d += delta * F[k];
+}
+
+double StateSpace::Process(double u)
+{
+	const double* pA = nStates ? &A[0] : NULL;
+	
+	// y = C * x + D * u + d
+	double y = D * u + d;
+	for(unsigned int i=0; i<nStates; i++)
+		y += C[i] * x[i];
+	
+	// x = A * x + B * u + c
+	for(unsigned int r=0; r<nStates; r++)
+	{
+		double sum = B[r] * u + c[r];
+		const double* row = pA + r * nStates;
+		for(unsigned int k=0; k<nStates; k++)
+			sum += row[k] * x[k];
+		xNext[r] = sum;
+	}
+	
+	maxChange = 0.0;
+	for(unsigned int i=0; i<nStates; i++)
+	{
+		maxChange = fmax(maxChange, fabs(xNext[i] - x[i]));
+		x[i] = xNext[i];
+	}
+	
+	return y;
+}
+
+void StateSpace::Clear()
+{
+	x.assign(nStates, 0.0);
+	maxChange = 0.0;
+}
+
+double StateSpace::GetMaxChange()
+{
+	return maxChange;
+}
@@ -0,0 +1,149 @@
+//
+//  StateSpace.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 16..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef StateSpace_hpp
+#define StateSpace_hpp
+
+#include <vector>
+
+using namespace std;
+
+/**
+ A class of the discrete-time single-input single-output state-space system.
+ 
+ x[n+1] = A * x[n] + B * u[n] + c
+ y[n] = C * x[n] + D * u[n] + d
+ 
+ c and d are the contributions of the constant sources. The matrices are stored as row-major arrays, so the update is a small dense loop.
+ 
+ The system is affine in the constant sources too(c = E * w + c0, d = F * w + d0 for the values w), so a change of a source only moves c and d by its column of E and F.
+ */
+class StateSpace
+{
+public:
+	StateSpace();
+	~StateSpace();
+	
+	/**
+	 Set the number of states and constant sources. All matrices and states are set to zero.
+	 
+	 @param nStates the number of states
+	 @param nSources the number of constant sources which can be changed
+	 */
+	void Resize(unsigned int nStates, unsigned int nSources=0);
+	
+	/**
+	 Get the number of states
+	 
+	 @return the number of states
+	 */
+	unsigned int GetStateCount();
+	
+	/**
+	 Get the number of constant sources
+	 
+	 @return the number of constant sources
+	 */
+	unsigned int GetSourceCount();
+	
+	/**
+	 Move c and d by the change of a constant source. It doesn't allocate.
+	 
+	 @param k the index of the source
+	 @param delta the change of the value
+	 */
+	void ChangeSource(unsigned int k, double delta);
+	
+	/**
+	 Process a sample
+	 
+	 @param u input
+	 @return output
+	 */
+	double Process(double u);
+	
+	/**
+	 Set the states to zero
+	 */
+	void Clear();
+	
+	/**
+	 Get the largest change of the states in the last sample
+	 
+	 @return max |x[n+1] - x[n]|
+	 */
+	double GetMaxChange();
+	
+	/**
+	 the state transition matrix(nStates x nStates, row-major)
+	 */
+	vector<double> A;
+	
+	/**
+	 the input vector of the state update(nStates)
+	 */
+	vector<double> B;
+	
+	/**
+	 the output vector(nStates)
+	 */
+	vector<double> C;
+	
+	/**
+	 the constant vector of the state update(nStates)
+	 */
+	vector<double> c;
+	
+	/**
+	 the direct gain from the input to the output
+	 */
+	double D;
+	
+	/**
+	 the constant of the output
+	 */
+	double d;
+	
+	/**
+	 the changes of c by the constant sources(nStates x nSources, column k at E[k * nStates])
+	 */
+	vector<double> E;
+	
+	/**
+	 the changes of d by the constant sources(nSources)
+	 */
+	vector<double> F;
+	
+	/**
+	 the states
+	 */
+	vector<double> x;
+	
+protected:
+	/**
+	 the number of states
+	 */
+	unsigned int nStates;
+	
+	/**
+	 the number of constant sources
+	 */
+	unsigned int nSources;
+	
+	/**
+	 the working memory for the next states
+	 */
+	vector<double> xNext;
+	
+	/**
+	 the largest change of the states in the last sample
+	 */
+	double maxChange;
+};
+
+#endif /* StateSpace_hpp */
@@ -1,3 +1,4 @@
+#include <stdexcept>
 #include "WDF.hpp"
 
 #define	DEFAULT_CHILDREN_COUNT_FOR_ADAPTOR		100
@@ -76,6 +77,12 @@ WDFObject::~WDFObject()
 	
 }
 
+WDFObject* WDFObject::Clone()
+{
+	// not supported
+	return NULL;
+}
+
 void WDFObject::AddChild(WDFObject* child)
 {
 	child->parent = this;
@@ -146,6 +153,11 @@ WDFResistor::~WDFResistor()
 
 }
 
+WDFObject* WDFResistor::Clone()
+{
+	return new WDFResistor(*this);
+}
+
 void WDFResistor::WaveUp()
 {
 	// b = 0
@@ -156,7 +168,9 @@ void WDFResistor::WaveUp()
 //============================================================
 WDFCapacitor::WDFCapacitor(double C, double T, string lbl, WDFType type) : WDFLeaf(T / (2.0 * C), lbl, type)
 {
+	this->C = C;
 	this->T = T;
+	antiDenormal = 0.0;
 }
 
 WDFCapacitor::~WDFCapacitor()
@@ -164,10 +178,26 @@ WDFCapacitor::~WDFCapacitor()
 
 }
 
+WDFObject* WDFCapacitor::Clone()
+{
+	return new WDFCapacitor(*this);
+}
+
 void WDFCapacitor::WaveUp()
 {
 	// b = z^-1 * a
-	vecPorts[RFP]->b = vecPorts[RFP]->a;
+	// the offset alternates its sign, so the decaying wave stays around it instead of becoming denormal
+	// (a real sum, which isn't reassociated away by -ffast-math)
+	vecPorts[RFP]->b = vecPorts[RFP]->a + antiDenormal;
+	antiDenormal = -antiDenormal;
+}
+
+void WDFCapacitor::SetSamplingTime(double T)
+{
+	// R = T / 2C
+	this->T = T;
+	vecPorts[RFP]->Rp = T / (2.0 * C);
+	vecPorts[RFP]->Gp = 1.0 / vecPorts[RFP]->Rp;
 }
 
 //============================================================
@@ -175,7 +205,9 @@ void WDFCapacitor::WaveUp()
 //============================================================
 WDFInductor::WDFInductor(double L, double T, string lbl, WDFType type) : WDFLeaf((2.0 * L) / T, lbl, type)
 {
+	this->L = L;
 	this->T = T;
+	antiDenormal = 0.0;
 }
 
 WDFInductor::~WDFInductor()
@@ -183,10 +215,25 @@ WDFInductor::~WDFInductor()
 
 }
 
+WDFObject* WDFInductor::Clone()
+{
+	return new WDFInductor(*this);
+}
+
 void WDFInductor::WaveUp()
 {
 	// b = z^-1 * (-a)
-	vecPorts[RFP]->b = -vecPorts[RFP]->a;
+	// the offset of alternating sign keeps the decaying wave from becoming denormal(as the capacitor)
+	vecPorts[RFP]->b = antiDenormal - vecPorts[RFP]->a;
+	antiDenormal = -antiDenormal;
+}
+
+void WDFInductor::SetSamplingTime(double T)
+{
+	// R = 2L / T
+	this->T = T;
+	vecPorts[RFP]->Rp = (2.0 * L) / T;
+	vecPorts[RFP]->Gp = 1.0 / vecPorts[RFP]->Rp;
 }
 
 //============================================================
@@ -202,6 +249,11 @@ WDFVoltageSource::~WDFVoltageSource()
 
 }
 
+WDFObject* WDFVoltageSource::Clone()
+{
+	return new WDFVoltageSource(*this);
+}
+
 void WDFVoltageSource::WaveUp()
 {
 	// b = volatage value
@@ -221,6 +273,11 @@ WDFOpenCircuit::~WDFOpenCircuit()
 	
 }
 
+WDFObject* WDFOpenCircuit::Clone()
+{
+	return new WDFOpenCircuit(*this);
+}
+
 void WDFOpenCircuit::WaveUp()
 {
 	// b = z^(-1) * a
@@ -300,6 +357,11 @@ WDFInverter::~WDFInverter()
 
 }
 
+WDFObject* WDFInverter::Clone()
+{
+	return new WDFInverter(*this);
+}
+
 void WDFInverter::CalculatePortResistance()
 {
 	// get port resistance from the child
@@ -346,6 +408,11 @@ WDFIdealTransformer::~WDFIdealTransformer()
 
 }
 
+WDFObject* WDFIdealTransformer::Clone()
+{
+	return new WDFIdealTransformer(*this);
+}
+
 void WDFIdealTransformer::CalculatePortResistance()
 {
 	// UP-port = primary, DOWN-port = secondary
@@ -391,6 +458,11 @@ WDFGyrator::~WDFGyrator()
 	
 }
 
+WDFObject* WDFGyrator::Clone()
+{
+	return new WDFGyrator(*this);
+}
+
 void WDFGyrator::CalculatePortResistance()
 {
 	// UP-port = primary, DOWN-port = secondary
@@ -434,6 +506,11 @@ WDFDualizer::~WDFDualizer()
 	
 }
 
+WDFObject* WDFDualizer::Clone()
+{
+	return new WDFDualizer(*this);
+}
+
 void WDFDualizer::CalculatePortResistance()
 {
 	// UP-port = primary, DOWN-port = secondary
@@ -483,6 +560,11 @@ WDFSeries::~WDFSeries()
 
 }
 
+WDFObject* WDFSeries::Clone()
+{
+	return new WDFSeries(*this);
+}
+
 void WDFSeries::CalculatePortResistance()
 {
 	// get children's port resistances
@@ -563,6 +645,11 @@ WDFParallel::~WDFParallel()
 
 }
 
+WDFObject* WDFParallel::Clone()
+{
+	return new WDFParallel(*this);
+}
+
 void WDFParallel::CalculatePortResistance()
 {
 	// get children's port resistances
@@ -627,24 +714,31 @@ void WDFParallel::WaveDown()
 //============================================================
 WDFRTypeAdaptor::WDFRTypeAdaptor(unsigned int nPorts, unsigned int nChildren, unsigned int nNodes, string lbl, WDFType type) : WDFAdaptor(nPorts, nChildren, lbl, type), MNA(nNodes, nPorts)
 {
+	WDFRTypeMatrices& m = matrices.Write();
+	
 	// [0 I]
-	mat ZI = zeros<mat>(nPorts, X.n_rows);
+	mat ZI = zeros<mat>(nPorts, GetSystemSize());
 	long i=ZI.n_rows-1, j=ZI.n_cols-1;
 	while(i >= 0 && j >= 0)
 		ZI(i--,j--) = 1;
 
 	// [0 I]^T
-	ZIt = ZI.t();
+	m.ZIt = ZI.t();
 
 	// [0 R]
-	ZR = zeros<mat>(nPorts, X.n_rows);
+	m.ZR = zeros<mat>(nPorts, GetSystemSize());
 
 	// I
-	I = eye<mat>(ZI.n_rows, ZI.n_rows);
+	m.I = eye<mat>(ZI.n_rows, ZI.n_rows);
+	matrices.Publish();
 	
 	// a, b
 	a = mat(nPorts, 1);
 	b = mat(nPorts, 1);
+	kernelS = GetMatVecKernel(nPorts, nPorts);
+	
+	// the connections are stamped at once by UpdateScatteringMatrix
+	BeginStamp();
 }
 
 WDFRTypeAdaptor::~WDFRTypeAdaptor()
@@ -652,6 +746,22 @@ WDFRTypeAdaptor::~WDFRTypeAdaptor()
 
 }
 
+WDFObject* WDFRTypeAdaptor::Clone()
+{
+	return new WDFRTypeAdaptor(*this);
+}
+
+void WDFRTypeAdaptor::UpdatePortResistance()
+{
+	WDFAdaptor::UpdatePortResistance();
+	
+	// re-stamp the resistors of Thevenin ports whose resistance is changed into X(published with the factorization)
+	for(unsigned int i=0; i<vecPorts.size() && i<GetResistorCount(); i++)
+		SetConductance(i, vecPorts[i]->Gp, false);
+	
+	UpdateScatteringMatrix();
+}
+
 void WDFRTypeAdaptor::CalculatePortResistance()
 {
 	// get children's port resistances
@@ -677,16 +787,18 @@ void WDFRTypeAdaptor::WaveUp()
 		(*iter)->a = (*iter)->coupledPort->b;
 
 	// set incident waves to the up port
-	unsigned int nPorts = (unsigned int)vecPorts.size();
+	const unsigned int nPorts = (unsigned int)vecPorts.size();
+	double* pa = a.memptr();
+	double* pb = b.memptr();
 	for(unsigned int i=0; i<nPorts; i++)
-		a(i,0) = vecPorts[i]->a;
+		pa[i] = vecPorts[i]->a;
 
-	// calculate reflected waves
-	b = S*a;
+	// calculate reflected waves(b = S * a) without temporaries
+	kernelS(matrices->S.memptr(), pa, pb, nPorts, nPorts, false);
 
 	// set reflected waves to the down ports
 	for(unsigned int i=0; i<nPorts; i++)
-		vecPorts[i]->b = b(i,0);
+		vecPorts[i]->b = pb[i];
 }
 
 void WDFRTypeAdaptor::WaveDown()
@@ -719,16 +831,27 @@ void WDFRTypeAdaptor::Connect(unsigned int iResistor, unsigned int iVoltageSourc
 
 void WDFRTypeAdaptor::UpdateScatteringMatrix()
 {
+	// the system matrix is assembled by SolvePortBlock if the connections are being stamped
+	WDFRTypeMatrices& m = matrices.Write();
+	
 	// update scattering matrix
 	// S = I + 2 * [0 R] * X^(-1) * [0 I]^T
-	long a=ZR.n_rows-1, b=ZR.n_cols-1;
+	long a=m.ZR.n_rows-1, b=m.ZR.n_cols-1;
 	while(a >= 0 && b >= 0)
 	{
-		ZR(a,b) = vecPorts[a]->Rp;
+		m.ZR(a,b) = vecPorts[a]->Rp;
 		a--; b--;
 	}
 	
-	S = I + 2 * ZR * inv(X) * ZIt;
+	// only the port block of X^(-1) is solved: S = I + 2 * R * ([0 I] * X^(-1) * [0 I]^T)
+	const unsigned int nPorts = (unsigned int)m.ZR.n_rows;
+	const unsigned int offset = (unsigned int)m.ZR.n_cols - nPorts;
+	mat Z = SolvePortBlock(nPorts);
+	m.S = mat(nPorts, nPorts);
+	for(unsigned int c=0; c<nPorts; c++)
+		for(unsigned int r=0; r<nPorts; r++)
+			m.S(r,c) = m.I(r,c) + 2.0 * m.ZR(r, offset + r) * Z(r,c);
+	matrices.Publish();
 //	S.save("S.txt", raw_ascii);
 	
 //	Y.save("Y.txt", raw_ascii);
@@ -745,15 +868,44 @@ void WDFRTypeAdaptor::UpdateScatteringMatrix()
 WDFRTypeAdaptorNL::WDFRTypeAdaptorNL(unsigned int nNLs, unsigned int nSubTrees, unsigned int nInternals, string lbl) : WDFAdaptor(nNLs+nSubTrees, nSubTrees, lbl, WDFType::R_TYPE_NL), MNA(nNLs+nSubTrees+nInternals, nNLs+nSubTrees), model(CircuitModel::DEFAULT)
 {
 	this->nNLs = nNLs;
+	solver.Reset(new NewtonSolver());
+	solverMaxIter = 100;
+	solverEpsilon = 1e-9;
+	predictor = NonlinearPredictor::KMETHOD;
+	predictorOrder = 2;
+	nHistory = 0;
 	CreateMatrices(nNLs, nSubTrees);
 	bFirstWave = true;
+	bValidADAA = false;
+	
+	bLinearized = false;
+	bValidLinear = false;
+	vTolerance = 1e-3;
+	aTolerance = 1e-1;
+	nLinearSamples = nTotalSamples = 0;
+	
+	// the connections are stamped at once by UpdateMatrices
+	BeginStamp();
 }
 
 WDFRTypeAdaptorNL::WDFRTypeAdaptorNL(WDFObject* left, WDFObject* right, unsigned int nNLs, CircuitModel model, string label) : WDFAdaptor(nNLs+2, 2, label, WDFType::R_TYPE_NL), MNA(0, 0), model(model)
 {
 	this->nNLs = nNLs;
+	solver.Reset(new NewtonSolver());
+	solverMaxIter = 100;
+	solverEpsilon = 1e-9;
+	predictor = NonlinearPredictor::KMETHOD;
+	predictorOrder = 2;
+	nHistory = 0;
 	CreateMatrices(nNLs, 2);	// the number of subtrees is 2(left & right)
 	bFirstWave = true;
+	bValidADAA = false;
+	
+	bLinearized = false;
+	bValidLinear = false;
+	vTolerance = 1e-3;
+	aTolerance = 1e-1;
+	nLinearSamples = nTotalSamples = 0;
 	
 	// create nonlinear ports
 	for(unsigned int i=0; i<nNLs; i++)
@@ -782,6 +934,22 @@ WDFRTypeAdaptorNL::~WDFRTypeAdaptorNL()
 	
 }
 
+WDFObject* WDFRTypeAdaptorNL::Clone()
+{
+	return new WDFRTypeAdaptorNL(*this);
+}
+
+void WDFRTypeAdaptorNL::UpdatePortResistance()
+{
+	WDFAdaptor::UpdatePortResistance();
+	
+	// re-stamp the resistors of Thevenin ports whose resistance is changed into X(MNA only, published with the factorization)
+	for(unsigned int i=0; i<vecPorts.size() && i<GetResistorCount(); i++)
+		SetConductance(i, vecPorts[i]->Gp, false);
+	
+	UpdateMatrices();
+}
+
 void WDFRTypeAdaptorNL::CalculatePortResistance()
 {
 	// get the children's port resistances
@@ -798,6 +966,8 @@ void WDFRTypeAdaptorNL::CalculatePortResistance()
 
 void WDFRTypeAdaptorNL::WaveUp()
 {
+	const WDFRTypeNLMatrices& m = *matrices;
+	
 	// 1. Process wave propagation from the children
 	for(vec_wdfobjptr::iterator iter = vecChildren.begin(); iter != vecChildren.end(); iter++)
 		(*iter)->WaveUp();
@@ -807,43 +977,102 @@ void WDFRTypeAdaptorNL::WaveUp()
 		(*iter)->a = (*iter)->coupledPort->b;
 	
 	// 3. Set incident waves to the external-wave vector
-	unsigned int nChildren = (unsigned int)vecChildren.size();
+	const unsigned int nChildren = (unsigned int)vecChildren.size();
+	double* pa = a_e.memptr();
 	for(unsigned int i=0; i<nChildren; i++)
-		a_e(i) = vecPorts[nNLs+i]->a;
+		pa[i] = vecPorts[nNLs+i]->a;
 	
 	//============================================================
-	// 4. Execute Newton-Raphson iteration
-	// 4-1. Guess initial value
-	vec v_c(nNLs), i_c(nNLs);
-	if(bFirstWave)
+	// 4. Execute Newton-Raphson iteration(in the workspace, no allocation)
+	double* v_c = vWork.memptr();
+	double* i_c = iWork.memptr();
+	bool bLinear = false;
+	nTotalSamples++;
+	
+	// 4-0. Linear update inside the region around the operating point
+	if(bLinearized && bValidLinear)
 	{
-		v_c.fill(0);
-		bFirstWave = false;
+		double aDistance = 0.0;
+		for(unsigned int i=0; i<nChildren; i++)
+			aDistance = std::max(aDistance, fabs(pa[i] - a_lin(i)));
+		
+		if(aDistance <= aTolerance)
+		{
+			// v = P * a_e + q
+			kernelE(P_lin.memptr(), pa, v_c, nNLs, nChildren, false);
+			double vDistance = 0.0;
+			for(unsigned int i=0; i<nNLs; i++)
+			{
+				v_c[i] += q_lin(i);
+				tWork(i) = v_c[i] - v_lin(i);
+				vDistance = std::max(vDistance, fabs(tWork(i)));
+			}
+			
+			if(vDistance <= vTolerance)
+			{
+				// i = i_lin + J * (v - v_lin)
+				kernelF(J_lin.memptr(), tWork.memptr(), i_c, nNLs, nNLs, false);
+				for(unsigned int i=0; i<nNLs; i++)
+					i_c[i] += i_lin(i);
+				bLinear = true;
+				nHistory = 0;	// the solutions of the predictor aren't contiguous
+				nLinearSamples++;
+			}
+		}
 	}
-	else
+	
+	if(!bLinear)
 	{
-		v_c = E * a_e + F * i_c_prev;
+		// 4-1. Guess initial value(E * a_e is constant during the iteration)
+		kernelE(m.E.memptr(), pa, pWork.memptr(), nNLs, nChildren, false);
+		if(bFirstWave)
+		{
+			for(unsigned int i=0; i<nNLs; i++)
+				v_c[i] = 0.0;
+			bFirstWave = false;
+		}
+		else
+			Predict(v_c);
+		
+		// 4-2. Execute iteration
+		solver->Solve(*this, v_c, nNLs, solverMaxIter, solverEpsilon);
+		PushSolution(v_c);
+		
+		// 4-3. Get current value(i_c)
+		Nonlinear(v_c, i_c);
+		
+		// move the operating point
+		if(bLinearized)
+			Linearize(v_c, i_c);
 	}
 	
-	// 4-2. Execute iteration
-	v_c = Solve(v_c);
-	
-	// 4-3. Get current value(i_c)
-	i_c = Nonlinear(v_c);
+	// 4-4. Antiderivative anti-aliasing(one-port only)
+	double* i_out = iOutWork.memptr();
+	for(unsigned int i=0; i<nNLs; i++)
+		i_out[i] = i_c[i];
+	if(nNLs == 1)
+	{
+		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[0]->coupledPort->owner;
+		if(leaf->IsAntialiased())
+			i_out[0] = AntialiasCurrent(leaf, v_c[0], i_c[0]);
+	}
 	//============================================================
 //	a_e.print("a:");
-//	v_c.print("v:");
-//	i_c.print("i:");
+//	vWork.print("v:");
+//	iWork.print("i:");
 	
-	// 5. Calculate reflected waves
-	b_e = M * a_e + N * i_c;
+	// 5. Calculate reflected waves(b_e = M * a_e + N * i_out)
+	double* pb = b_e.memptr();
+	kernelM(m.M.memptr(), pa, pb, nChildren, nChildren, false);
+	kernelN(m.N.memptr(), i_out, pb, nChildren, nNLs, true);
 	
 	// 6. Set reflected waves to the down ports
 	for(unsigned int i=0; i<nChildren; i++)
-		vecPorts[nNLs+i]->b = b_e(i);
+		vecPorts[nNLs+i]->b = pb[i];
 	
 	// 7. Save current value for next step
-	i_c_prev = i_c;
+	for(unsigned int i=0; i<nNLs; i++)
+		i_c_prev(i) = i_c[i];
 	
 	// 8. update the values
 	UpdateNonlinearValues(v_c, i_c);
@@ -917,6 +1146,16 @@ void WDFRTypeAdaptorNL::ConnectNL(WDFRTypeRootLeaf* rootLeaf)
 
 void WDFRTypeAdaptorNL::UpdateMatrices()
 {
+	// the system matrix is assembled by SolvePortBlock if the connections are being stamped(MNA only)
+	if(model != CircuitModel::DEFAULT)
+		EndStamp();
+	
+	WDFRTypeNLMatrices& m = matrices.Write();
+	
+	// the antiderivative & the linearization depend on F
+	bValidADAA = false;
+	bValidLinear = false;
+	
 	//============================================================
 	// Update CONVERSION matrices
 	//============================================================
@@ -925,17 +1164,17 @@ void WDFRTypeAdaptorNL::UpdateMatrices()
 	// C = [[C11, C12], [C21, C22]] = [[-Ri, I], [-2Ri, I]]
 	for(unsigned int i=0; i<nNLs; i++)
 	{
-		C11(i,i) = -vecPorts[i]->Rp;
-		C21(i,i) = -2.0 * vecPorts[i]->Rp;
+		m.C11(i,i) = -vecPorts[i]->Rp;
+		m.C21(i,i) = -2.0 * vecPorts[i]->Rp;
 	}
-	for(unsigned int r=0; r<C.n_rows; r++)
+	for(unsigned int r=0; r<m.C.n_rows; r++)
 	{
-		for(unsigned int c=0; c<C.n_cols; c++)
+		for(unsigned int c=0; c<m.C.n_cols; c++)
 		{
-			if(r < nNLs && c < nNLs)		C(r,c) = C11(r, c);
-			else if(r < nNLs && c >= nNLs)	C(r,c) = C12(r, c-nNLs);
-			else if(r >= nNLs && c < nNLs)	C(r,c) = C21(r-nNLs, c);
-			else if(r >= nNLs && c >= nNLs)	C(r,c) = C22(r-nNLs, c-nNLs);
+			if(r < nNLs && c < nNLs)		m.C(r,c) = m.C11(r, c);
+			else if(r < nNLs && c >= nNLs)	m.C(r,c) = m.C12(r, c-nNLs);
+			else if(r >= nNLs && c < nNLs)	m.C(r,c) = m.C21(r-nNLs, c);
+			else if(r >= nNLs && c >= nNLs)	m.C(r,c) = m.C22(r-nNLs, c-nNLs);
 		}
 	}
 //	C.save("C.txt", raw_ascii);
@@ -945,23 +1184,28 @@ void WDFRTypeAdaptorNL::UpdateMatrices()
 	//============================================================
 	// create [0 R]
 	// R = diag(Ri, Re)
-	long i=ZR.n_rows-1, j=ZR.n_cols-1;
+	long i=m.ZR.n_rows-1, j=m.ZR.n_cols-1;
 	while(i >= 0 && j >= 0)
 	{
-		ZR(i,j) = vecPorts[i]->Rp;
+		m.ZR(i,j) = vecPorts[i]->Rp;
 		i--; j--;
 	}
 	
 	if(model == CircuitModel::DEFAULT)		// MNA is enable
 	{
-		// S = I + 2 * [0 R] * X^(-1) * [0 I]^T
-		mat I = eye<mat>(ZR.n_rows, ZIt.n_cols);
-		S = I + 2 * ZR * X.i() * ZIt;
+		// S = I + 2 * [0 R] * X^(-1) * [0 I]^T, only the port block of X^(-1) is solved
+		const unsigned int nPorts = (unsigned int)m.ZR.n_rows;
+		const unsigned int offset = (unsigned int)m.ZR.n_cols - nPorts;
+		mat Z = SolvePortBlock(nPorts);
+		m.S = mat(nPorts, nPorts);
+		for(unsigned int c=0; c<nPorts; c++)
+			for(unsigned int r=0; r<nPorts; r++)
+				m.S(r,c) = ((r == c) ? 1.0 : 0.0) + 2.0 * m.ZR(r, offset + r) * Z(r,c);
 //		S.load("Smat.txt");
 	}
 	else
 	{
-		S = mat(S11.n_rows + S21.n_rows, S11.n_cols + S12.n_cols);
+		m.S = mat(m.S11.n_rows + m.S21.n_rows, m.S11.n_cols + m.S12.n_cols);
 		// reflection coefficient of each port
 		const unsigned int size = (unsigned int)vecPorts.size();
 		double *refs = new double[size];
@@ -977,9 +1221,9 @@ void WDFRTypeAdaptorNL::UpdateMatrices()
 				refs[i] = 2.0 * vecPorts[i]->Gp / Gp_total;
 			
 			// set scattering matrix
-			for(unsigned int r=0; r<S.n_rows; r++)
-				for(unsigned int c=0; c<S.n_cols; c++)
-					S(r,c) = (r == c) ? (refs[c]-1.0) : refs[c];
+			for(unsigned int r=0; r<m.S.n_rows; r++)
+				for(unsigned int c=0; c<m.S.n_cols; c++)
+					m.S(r,c) = (r == c) ? (refs[c]-1.0) : refs[c];
 		}
 		else	// series
 		{
@@ -992,39 +1236,49 @@ void WDFRTypeAdaptorNL::UpdateMatrices()
 				refs[i] = 2.0 * vecPorts[i]->Rp / Rp_total;
 			
 			// set scattering matrix
-			for(unsigned int r=0; r<S.n_rows; r++)
-				for(unsigned int c=0; c<S.n_cols; c++)
-					S(r,c) = (r == c) ? (1.0-refs[r]) : -refs[r];
+			for(unsigned int r=0; r<m.S.n_rows; r++)
+				for(unsigned int c=0; c<m.S.n_cols; c++)
+					m.S(r,c) = (r == c) ? (1.0-refs[r]) : -refs[r];
 		}
 		delete[] refs;
 	}
 	
 	// partition S into S11 ~ S22
-	for(unsigned int r=0; r<S.n_rows; r++)
+	for(unsigned int r=0; r<m.S.n_rows; r++)
 	{
-		for(unsigned int c=0; c<S.n_cols; c++)
+		for(unsigned int c=0; c<m.S.n_cols; c++)
 		{
 			if(r < nNLs && c < nNLs)
-				S11(r,c) = S(r,c);
+				m.S11(r,c) = m.S(r,c);
 			else if(r < nNLs && c >= nNLs)
-				S12(r,c-nNLs) = S(r,c);
+				m.S12(r,c-nNLs) = m.S(r,c);
 			else if(r >= nNLs && c < nNLs)
-				S21(r-nNLs, c) = S(r,c);
+				m.S21(r-nNLs, c) = m.S(r,c);
 			else
-				S22(r-nNLs, c-nNLs) = S(r,c);
+				m.S22(r-nNLs, c-nNLs) = m.S(r,c);
 		}
 	}
 //	S.save("S.txt", raw_ascii);
 	
 	//============================================================
 	// create H, E, F, M, N
-	mat I = eye<mat>(C22.n_rows, S11.n_cols);
+	mat I = eye<mat>(m.C22.n_rows, m.S11.n_cols);
 //	S11.print("S11:");
-	mat H = inv(I - C22 * S11);
-	E = C12 * (I + S11 * H * C22) * S12;
-	F = C12 * S11 * H *	C21 + C11;
-	M = S21 * H * C22 * S12 + S22;
-	N = S21 * H * C21;
+	// H = (I - C22 * S11)^(-1) is factorized once and applied to both products
+	MNA_LU H;
+	if(!H.Factorize(I - m.C22 * m.S11))
+		throw std::runtime_error("R-Type NL: I - C22 * S11 is singular");
+	mat HC22S12 = H.Solve(m.C22 * m.S12);
+	mat HC21 = H.Solve(m.C21);
+	
+	m.E = m.C12 * (m.S12 + m.S11 * HC22S12);
+	m.F = m.C12 * m.S11 * HC21 + m.C11;
+	m.M = m.S21 * HC22S12 + m.S22;
+	m.N = m.S21 * HC21;
+	
+	// the system is changed
+	solver->Prepare(*this, nNLs);
+	matrices.Publish();
 	
 //	E.save("E.txt", raw_ascii);
 //	F.save("F.txt", raw_ascii);
@@ -1034,16 +1288,18 @@ void WDFRTypeAdaptorNL::UpdateMatrices()
 
 void WDFRTypeAdaptorNL::CreateMatrices(unsigned int nNLs, unsigned int nSubTrees)
 {
+	WDFRTypeNLMatrices& m = matrices.Write();
+	
 	//============================================================
 	// Set the size of conversion matrices
 	// Ri = nNLs x nNLs
 	// Re = nSubTrees x nSubTrees
 	//============================================================
-	C11 = zeros<mat>(nNLs, nNLs);	// -Ri
-	C12 = eye<mat>(nNLs, nNLs);		// I
-	C21 = zeros<mat>(nNLs, nNLs);	// -2Ri
-	C22 = eye<mat>(nNLs, nNLs);		// I
-	C = mat(nNLs*2, nNLs*2);
+	m.C11 = zeros<mat>(nNLs, nNLs);	// -Ri
+	m.C12 = eye<mat>(nNLs, nNLs);		// I
+	m.C21 = zeros<mat>(nNLs, nNLs);	// -2Ri
+	m.C22 = eye<mat>(nNLs, nNLs);		// I
+	m.C = mat(nNLs*2, nNLs*2);
 	
 	//============================================================
 	// Set the size of scattering matrices
@@ -1051,22 +1307,23 @@ void WDFRTypeAdaptorNL::CreateMatrices(unsigned int nNLs, unsigned int nSubTrees
 	//============================================================
 	// [0 I]
 	unsigned int nPorts = nNLs + nSubTrees;
-	mat ZI = zeros<mat>(nPorts, X.n_rows);
+	mat ZI = zeros<mat>(nPorts, GetSystemSize());
 	long i=ZI.n_rows-1, j=ZI.n_cols-1;
 	while(i >= 0 && j >= 0)
 		ZI(i--,j--) = 1;
 	
 	// [0 I]^T
-	ZIt = ZI.t();
+	m.ZIt = ZI.t();
 	
 	// [0 R]
-	ZR = zeros<mat>(nPorts, X.n_rows);
+	m.ZR = zeros<mat>(nPorts, GetSystemSize());
 	
 	// S11, S12, S21, S22
-	S11 = mat(nNLs, nNLs);
-	S12 = mat(nNLs, nSubTrees);
-	S21 = mat(nSubTrees, nNLs);
-	S22 = mat(nSubTrees, nSubTrees);
+	m.S11 = mat(nNLs, nNLs);
+	m.S12 = mat(nNLs, nSubTrees);
+	m.S21 = mat(nSubTrees, nNLs);
+	m.S22 = mat(nSubTrees, nSubTrees);
+	matrices.Publish();
 	
 	//============================================================
 	// a, b(for the external)
@@ -1074,110 +1331,411 @@ void WDFRTypeAdaptorNL::CreateMatrices(unsigned int nNLs, unsigned int nSubTrees
 	a_e = vec(nSubTrees);
 	b_e = vec(nSubTrees);
 	
+	//============================================================
+	// kernels of E(nNLs x nSubTrees), F(nNLs x nNLs), M(nSubTrees x nSubTrees), N(nSubTrees x nNLs)
+	//============================================================
+	kernelE = GetMatVecKernel(nNLs, nSubTrees);
+	kernelF = GetMatVecKernel(nNLs, nNLs);
+	kernelM = GetMatVecKernel(nSubTrees, nSubTrees);
+	kernelN = GetMatVecKernel(nSubTrees, nNLs);
+	
 	//============================================================
 	// previous voltage values
 	//============================================================
 	i_c_prev = vec(nNLs);
 	i_c_prev.fill(0);
+	
+	//============================================================
+	// workspace of the per-sample path
+	//============================================================
+	vWork = zeros<vec>(nNLs);
+	iWork = zeros<vec>(nNLs);
+	iOutWork = zeros<vec>(nNLs);
+	pWork = zeros<vec>(nNLs);
+	tWork = zeros<vec>(nNLs);
+	dIWork = zeros<mat>(nNLs, nNLs);
+	KWork = zeros<mat>(nNLs, nNLs);
+	pivotWork.resize(nNLs);
+	
+	// the solutions of the previous samples for the predictor
+	vHistory = zeros<mat>(nNLs, MAX_PREDICTOR_ORDER);
+	pPrev = zeros<vec>(nNLs);
+	nHistory = 0;
+	
+	// the operating point of the linearized mode
+	P_lin = zeros<mat>(nNLs, nSubTrees);
+	J_lin = zeros<mat>(nNLs, nNLs);
+	q_lin = zeros<vec>(nNLs);
+	v_lin = zeros<vec>(nNLs);
+	i_lin = zeros<vec>(nNLs);
+	a_lin = zeros<vec>(nSubTrees);
 }
 
 vec WDFRTypeAdaptorNL::Evaluate(vec v_c)
 {
-	return E * a_e + F * Nonlinear(v_c) - v_c;
+	// F(v) = E * a_e + F * i(v) - v
+	kernelE(matrices->E.memptr(), a_e.memptr(), pWork.memptr(), nNLs, (unsigned int)a_e.n_elem, false);
+	
+	vec f(nNLs);
+	Evaluate(v_c.memptr(), f.memptr());
+	return f;
+}
+
+void WDFRTypeAdaptorNL::Evaluate(const double* v_c, double* f)
+{
+	// F(v) = E * a_e + F * i(v) - v, E * a_e(pWork) is calculated once per sample
+	double* i_c = iWork.memptr();
+	Nonlinear(v_c, i_c);
+	
+	for(unsigned int i=0; i<nNLs; i++)
+		f[i] = pWork(i) - v_c[i];
+	kernelF(matrices->F.memptr(), i_c, f, nNLs, nNLs, true);
 }
 
 mat WDFRTypeAdaptorNL::GetJacobian(vec v_c)
 {
-	mat J(nNLs, nNLs), dI(nNLs, nNLs);
-	J.fill(0.0);
-	dI.fill(0.0);
+	mat J(nNLs, nNLs);
+	GetJacobian(v_c.memptr(), J.memptr());
+	return J;
+}
+
+void WDFRTypeAdaptorNL::GetJacobian(const double* v_c, double* J)
+{
+	double* dI = dIWork.memptr();
+	DiffNonlinear(v_c, dI);
+	AssembleJacobian(dI, J);
+}
+
+void WDFRTypeAdaptorNL::EvaluateWithJacobian(const double* v_c, double* f, double* J)
+{
+	// the devices evaluate the current & its Jacobian at once
+	double* i_c = iWork.memptr();
+	double* dI = dIWork.memptr();
+	NonlinearWithJacobian(v_c, i_c, dI);
 	
-	unsigned int i=0, j=0, r=0, c=0;
+	for(unsigned int i=0; i<nNLs; i++)
+		f[i] = pWork(i) - v_c[i];
+	kernelF(matrices->F.memptr(), i_c, f, nNLs, nNLs, true);
+	
+	AssembleJacobian(dI, J);
+}
+
+void WDFRTypeAdaptorNL::AssembleJacobian(const double* dI, double* J)
+{
+	// J = F * dI - I(column by column)
+	const double* F = matrices->F.memptr();
+	for(unsigned int c=0; c<nNLs; c++)
+	{
+		kernelF(F, &dI[c * nNLs], &J[c * nNLs], nNLs, nNLs, false);
+		J[c * nNLs + c] -= 1.0;
+	}
+}
+
+mat WDFRTypeAdaptorNL::DiffNonlinear(vec v_c)
+{
+	mat dI(nNLs, nNLs);
+	DiffNonlinear(v_c.memptr(), dI.memptr());
+	return dI;
+}
+
+void WDFRTypeAdaptorNL::DiffNonlinear(const double* v_c, double* dI)
+{
+	for(unsigned int k=0; k<nNLs*nNLs; k++)
+		dI[k] = 0.0;
+	
+	// each nonlinear element fills its diagonal block
+	unsigned int i=0;
 	do {
-		// get each nonlinear elements
 		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[i]->coupledPort->owner;
-		
-		// cut v_c
-		vec temp_v_c(leaf->vecPorts.size());
-		for(unsigned int a=0; a<temp_v_c.size(); a++)
-		{
-			temp_v_c(a) = v_c(j);
-			j++;
-		}
-		
-		// get Jacobian matrix
-		mat temp_dI = leaf->DiffNonlinear(temp_v_c);
-		
-		// copy to the differential current matrix
-		for(unsigned int a=0; a<temp_dI.n_rows; a++)
-		{
-			c = i;
-			for(unsigned int b=0; b<temp_dI.n_cols; b++)
-			{
-				dI(r,c) = temp_dI(a,b);
-				c++;
-			}
-			r++;
-		}
+		leaf->DiffNonlinear(&v_c[i], &dI[i * nNLs + i], nNLs);
 		
 		// update the indices
 		i += leaf->vecPorts.size();
 	} while(i < nNLs);
+}
+
+void WDFRTypeAdaptorNL::NonlinearWithJacobian(const double* v_c, double* i_c, double* dI)
+{
+	for(unsigned int k=0; k<nNLs*nNLs; k++)
+		dI[k] = 0.0;
 	
-	// calculate the whole matrix
-	J = F * dI - eye<mat>(F.n_rows, dI.n_cols);
-	
-	return J;
+	unsigned int i=0;
+	do {
+		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[i]->coupledPort->owner;
+		leaf->NonlinearWithJacobian(&v_c[i], &i_c[i], &dI[i * nNLs + i], nNLs);
+		
+		i += leaf->vecPorts.size();
+	} while(i < nNLs);
 }
 
 vec WDFRTypeAdaptorNL::Nonlinear(vec v_c)
 {
 	vec i_c(nNLs);
-	
-	unsigned int i=0, j=0;
+	Nonlinear(v_c.memptr(), i_c.memptr());
+	return i_c;
+}
+
+void WDFRTypeAdaptorNL::Nonlinear(const double* v_c, double* i_c)
+{
+	unsigned int i=0;
 	do
 	{
+		// each nonlinear element reads & writes its own ports
 		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[i]->coupledPort->owner;
+		leaf->Nonlinear(&v_c[i], &i_c[i]);
 		
-		// cut v_c
-		vec temp_v_c(leaf->vecPorts.size());
-		for(unsigned int a=0; a<temp_v_c.size(); a++)
-			temp_v_c(a) = v_c(j++);
-		
-		// execute nonlinear function
-		vec temp_i_c = leaf->Nonlinear(temp_v_c);
-		
-		// copy to current vector
-		for(unsigned int a=0; a<temp_i_c.size(); a++)
-			i_c(i++) = temp_i_c(a);
-		
+		i += leaf->vecPorts.size();
 	} while(i < nNLs);
-	
-	return i_c;
 }
 
-void WDFRTypeAdaptorNL::UpdateNonlinearValues(vec Vprev, vec Iprev)
+void WDFRTypeAdaptorNL::UpdateNonlinearValues(const double* Vprev, const double* Iprev)
 {
 	unsigned int i=0;
 	do
 	{
+		// set the current values of the ports of each element
 		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[i]->coupledPort->owner;
+		leaf->UpdateValues(&Vprev[i], &Iprev[i]);
 		
-		// cut Vprev & Iprev to the current port
-		vec Vtemp(leaf->vecPorts.size());
-		vec Itemp(leaf->vecPorts.size());
-		for(unsigned int a=0; a<Vtemp.size(); a++)
+		i += leaf->vecPorts.size();
+	} while(i < nNLs);
+}
+
+void WDFRTypeAdaptorNL::SetLinearizedMode(bool enable, double vTolerance, double aTolerance)
+{
+	bLinearized = enable;
+	bValidLinear = false;
+	this->vTolerance = vTolerance;
+	this->aTolerance = aTolerance;
+	nLinearSamples = nTotalSamples = 0;
+}
+
+bool WDFRTypeAdaptorNL::IsLinearizedMode()
+{
+	return bLinearized;
+}
+
+double WDFRTypeAdaptorNL::GetLinearizedRatio()
+{
+	return nTotalSamples ? (double)nLinearSamples / nTotalSamples : 0.0;
+}
+
+void WDFRTypeAdaptorNL::ResetOperatingPoint()
+{
+	bValidADAA = false;
+	bValidLinear = false;
+	nHistory = 0;
+}
+
+void WDFRTypeAdaptorNL::SetSolver(NonlinearSolverType type)
+{
+	SetSolver(NonlinearSolver::Create(type));
+}
+
+void WDFRTypeAdaptorNL::SetSolver(NonlinearSolver* solver)
+{
+	if(!solver)
+		return;
+	
+	// the budget, the fallback & the limiting are kept across the types
+	if(this->solver.Get())
+		solver->CopySettings(*this->solver.Get());
+	this->solver.Reset(solver);
+	
+	// prepare now if the matrices are ready, otherwise UpdateMatrices prepares it
+	if(!matrices->F.is_empty())
+		solver->Prepare(*this, nNLs);
+}
+
+NonlinearSolver* WDFRTypeAdaptorNL::GetSolver()
+{
+	return solver.Get();
+}
+
+void WDFRTypeAdaptorNL::SetSolverLimits(int max_iter, double epsilon)
+{
+	solverMaxIter = max_iter;
+	solverEpsilon = epsilon;
+}
+
+void WDFRTypeAdaptorNL::SetPredictor(NonlinearPredictor predictor, unsigned int order)
+{
+	this->predictor = predictor;
+	predictorOrder = std::max(1u, std::min(order, (unsigned int)MAX_PREDICTOR_ORDER));
+}
+
+NonlinearPredictor WDFRTypeAdaptorNL::GetPredictor()
+{
+	return predictor;
+}
+
+void WDFRTypeAdaptorNL::Predict(double* v_c)
+{
+	const double* v_prev = vHistory.memptr();
+	
+	if(nHistory == 0 || predictor == NonlinearPredictor::KMETHOD)
+	{
+		// E * a_e + F * i_prev
+		for(unsigned int i=0; i<nNLs; i++)
+			v_c[i] = pWork(i);
+		kernelF(matrices->F.memptr(), i_c_prev.memptr(), v_c, nNLs, nNLs, true);
+	}
+	else if(predictor == NonlinearPredictor::POLYNOMIAL)
+	{
+		// v[n] = sum of (-1)^(j + 1) * C(k, j) * v[n - j](j = 1 ~ k), the polynomial through the last k solutions
+		const unsigned int k = std::min(predictorOrder, nHistory);
+		for(unsigned int i=0; i<nNLs; i++)
+			v_c[i] = 0.0;
+		
+		double c = 1.0;
+		for(unsigned int j=1; j<=k; j++)
 		{
-			Vtemp(a) = Vprev(i);
-			Itemp(a) = Iprev(i);
-			i++;
+			c = c * (k - j + 1) / j;
+			const double coef = (j % 2) ? c : -c;
+			const double* col = v_prev + (j - 1) * nNLs;
+			for(unsigned int i=0; i<nNLs; i++)
+				v_c[i] += coef * col[i];
 		}
+	}
+	else
+	{
+		for(unsigned int i=0; i<nNLs; i++)
+			v_c[i] = v_prev[i];
 		
-		// set the current values
-		leaf->UpdateValues(Vtemp, Itemp);
+		// v_prev - J^(-1) * (p - p_prev): F(v_prev; p) = p - p_prev, so this is a Newton step by the last Jacobian
+		if(predictor == NonlinearPredictor::TANGENT)
+		{
+			double* dp = tWork.memptr();
+			for(unsigned int i=0; i<nNLs; i++)
+				dp[i] = pWork(i) - pPrev(i);
+			if(solver->SolveLastJacobian(dp))
+				for(unsigned int i=0; i<nNLs; i++)
+					v_c[i] -= dp[i];
+		}
+	}
+}
+
+void WDFRTypeAdaptorNL::PushSolution(const double* v_c)
+{
+	// shift the history by a column
+	double* hist = vHistory.memptr();
+	for(unsigned int k=MAX_PREDICTOR_ORDER-1; k>0; k--)
+		for(unsigned int i=0; i<nNLs; i++)
+			hist[k * nNLs + i] = hist[(k - 1) * nNLs + i];
+	
+	for(unsigned int i=0; i<nNLs; i++)
+	{
+		hist[i] = v_c[i];
+		pPrev(i) = pWork(i);
+	}
+	if(nHistory < MAX_PREDICTOR_ORDER)
+		nHistory++;
+}
+
+unsigned int WDFRTypeAdaptorNL::GetParameterSize()
+{
+	return nNLs;
+}
+
+void WDFRTypeAdaptorNL::GetParameter(double* p)
+{
+	for(unsigned int i=0; i<nNLs; i++)
+		p[i] = pWork(i);
+}
+
+void WDFRTypeAdaptorNL::SetParameter(const double* p)
+{
+	for(unsigned int i=0; i<nNLs; i++)
+		pWork(i) = p[i];
+}
+
+void WDFRTypeAdaptorNL::LimitStep(const double* v_old, double* v_new)
+{
+	unsigned int i=0;
+	do
+	{
+		WDFRTypeRootLeaf* leaf = (WDFRTypeRootLeaf*)vecPorts[i]->coupledPort->owner;
+		leaf->LimitVoltage(&v_old[i], &v_new[i]);
+		
+		i += leaf->vecPorts.size();
 	} while(i < nNLs);
 }
 
+void WDFRTypeAdaptorNL::Linearize(const double* v_c, const double* i_c)
+{
+	const WDFRTypeNLMatrices& m = *matrices;
+	const unsigned int nSubTrees = (unsigned int)a_e.n_elem;
+	
+	// i = i_lin + J * (v - v_lin), v = E * a_e + F * i
+	// -> (I - F * J) * v = E * a_e + F * (i_lin - J * v_lin)
+	DiffNonlinear(v_c, J_lin.memptr());
+	
+	// K = I - F * J
+	double* K = KWork.memptr();
+	for(unsigned int c=0; c<nNLs; c++)
+	{
+		kernelF(m.F.memptr(), &J_lin.memptr()[c * nNLs], &K[c * nNLs], nNLs, nNLs, false);
+		for(unsigned int r=0; r<nNLs; r++)
+			K[c * nNLs + r] = ((r == c) ? 1.0 : 0.0) - K[c * nNLs + r];
+	}
+	if(!LUFactorizeInPlace(K, nNLs, &pivotWork[0]))
+	{
+		bValidLinear = false;
+		return;
+	}
+	
+	// P = K^(-1) * E
+	for(unsigned int c=0; c<nSubTrees; c++)
+	{
+		for(unsigned int r=0; r<nNLs; r++)
+			P_lin(r,c) = m.E(r,c);
+		LUSolveInPlace(K, nNLs, &pivotWork[0], &P_lin.memptr()[c * nNLs]);
+	}
+	
+	// q = K^(-1) * F * (i - J * v)
+	kernelF(J_lin.memptr(), v_c, tWork.memptr(), nNLs, nNLs, false);
+	for(unsigned int i=0; i<nNLs; i++)
+		tWork(i) = i_c[i] - tWork(i);
+	kernelF(m.F.memptr(), tWork.memptr(), q_lin.memptr(), nNLs, nNLs, false);
+	LUSolveInPlace(K, nNLs, &pivotWork[0], q_lin.memptr());
+	
+	for(unsigned int i=0; i<nNLs; i++)
+	{
+		v_lin(i) = v_c[i];
+		i_lin(i) = i_c[i];
+	}
+	for(unsigned int i=0; i<nSubTrees; i++)
+		a_lin(i) = a_e(i);
+	bValidLinear = true;
+}
+
+double WDFRTypeAdaptorNL::AntialiasCurrent(WDFRTypeRootLeaf* leaf, double v, double i)
+{
+	// v = p + f * i, so the current is a function of p: i = h(p)
+	// H(p) = integral of h dp = G(v) - f * i^2 / 2, where G is the antiderivative of i(v)
+	// i[n] = (H(p[n]) - H(p[n-1])) / (p[n] - p[n-1])
+	const double f = matrices->F(0,0);
+	const double p = v - f * i;
+	const double H = leaf->Antiderivative(v) - 0.5 * f * i * i;
+	
+	double i_aa = i;
+	if(bValidADAA)
+	{
+		const double dp = p - p_prev;
+		if(fabs(dp) > 1e-6)
+			i_aa = (H - H_prev) / dp;
+		else
+			i_aa = 0.5 * (i + i_prev);	// ill-conditioned, use the average
+	}
+	
+	bValidADAA = true;
+	p_prev = p;
+	H_prev = H;
+	i_prev = i;
+	
+	return i_aa;
+}
+
 //============================================================
 // Root Leaf
 //============================================================
@@ -1272,6 +1830,7 @@ WDFRTypeRootLeaf::WDFRTypeRootLeaf(unsigned int nPorts, string lbl, WDFType type
 	// create matrices for previous voltage and current values
 	Vprev = zeros<vec>(nPorts);
 	Iprev = zeros<vec>(nPorts);
+	vWork = zeros<vec>(nPorts);
 }
 
 WDFRTypeRootLeaf::~WDFRTypeRootLeaf()
@@ -1315,3 +1874,78 @@ void WDFRTypeRootLeaf::UpdateValues(vec Vprev, vec Iprev)
 	this->Vprev = Vprev;
 	this->Iprev = Iprev;
 }
+
+void WDFRTypeRootLeaf::Nonlinear(const double* Vc, double* Ic)
+{
+	// the argument uses the workspace as its memory(the temporary is constructed in place of the parameter)
+	const unsigned int nPorts = (unsigned int)vecPorts.size();
+	double* V = vWork.memptr();
+	for(unsigned int i=0; i<nPorts; i++)
+		V[i] = Vc[i];
+	
+	const vec I = Nonlinear(vec(V, nPorts, false, true));
+	for(unsigned int i=0; i<nPorts; i++)
+		Ic[i] = I(i);
+}
+
+void WDFRTypeRootLeaf::DiffNonlinear(const double* Vc, double* J, unsigned int ld)
+{
+	const unsigned int nPorts = (unsigned int)vecPorts.size();
+	double* V = vWork.memptr();
+	for(unsigned int i=0; i<nPorts; i++)
+		V[i] = Vc[i];
+	
+	const mat dI = DiffNonlinear(vec(V, nPorts, false, true));
+	for(unsigned int c=0; c<nPorts; c++)
+		for(unsigned int r=0; r<nPorts; r++)
+			J[c * ld + r] = dI(r,c);
+}
+
+void WDFRTypeRootLeaf::NonlinearWithJacobian(const double* Vc, double* Ic, double* J, unsigned int ld)
+{
+	Nonlinear(Vc, Ic);
+	DiffNonlinear(Vc, J, ld);
+}
+
+void WDFRTypeRootLeaf::UpdateValues(const double* Vprev, const double* Iprev)
+{
+	for(unsigned int i=0; i<vecPorts.size(); i++)
+	{
+		this->Vprev(i) = Vprev[i];
+		this->Iprev(i) = Iprev[i];
+	}
+}
+
+void WDFRTypeRootLeaf::LimitVoltage(const double* Vold, double* Vnew)
+{
+	
+}
+
+double WDFRTypeRootLeaf::LimitJunctionVoltage(double vNew, double vOld, double nVt, double vCrit)
+{
+	// the step is limited logarithmically above the critical voltage, where the current grows exponentially
+	if(vNew > vCrit && fabs(vNew - vOld) > 2.0 * nVt)
+	{
+		if(vOld > 0.0)
+		{
+			const double arg = 1.0 + (vNew - vOld) / nVt;
+			vNew = (arg > 0.0) ? vOld + nVt * log(arg) : vCrit;
+		}
+		else
+		{
+			vNew = nVt * log(vNew / nVt);
+		}
+	}
+	
+	return vNew;
+}
+
+bool WDFRTypeRootLeaf::IsAntialiased()
+{
+	return false;
+}
+
+double WDFRTypeRootLeaf::Antiderivative(double Vc)
+{
+	return 0.0;
+}
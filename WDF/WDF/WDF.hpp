@@ -4,7 +4,9 @@
 #include <vector>
 #include <string>
 #include "MNA.hpp"
+#include "MatrixKernels.hpp"
 #include "NewtonRaphson.h"
+#include "NonlinearSolver.hpp"
 
 using namespace std;
 
@@ -84,6 +86,8 @@ public:
 	WDFObject(unsigned int nPorts, unsigned int nChildren, string lbl="WDFObject", WDFType type=WDFType::OBJECT);	// constructor with the size of ports & children
 	virtual ~WDFObject();								// destructor
 
+	virtual WDFObject* Clone();							// create a copy of this object(the ports, the parent and the children must be replaced by the caller)
+	
 	virtual void AddChild(WDFObject* child);			// couple the wdf objects(set this object to the parent)
 	virtual WDFPort* GetDecoupledPort();				// get WDFPort object not coupled
 
@@ -121,6 +125,7 @@ class WDFResistor : public WDFLeaf
 public:
 	WDFResistor(double R, string lbl="Resistor", WDFType type=WDFType::RESISTOR);
 	virtual ~WDFResistor();
+	virtual WDFObject* Clone();
 
 	virtual void WaveUp();
 };
@@ -131,12 +136,17 @@ public:
 class WDFCapacitor : public WDFLeaf
 {
 public:
+	double C;				// capacitance
 	double T;				// sampling interval
+	double antiDenormal;	// offset added to the stored wave, its sign alternates every sample(0: not used)
 
 	WDFCapacitor(double C, double T, string lbl="Capacitor", WDFType type=WDFType::CAPACITOR);
 	virtual ~WDFCapacitor();
+	virtual WDFObject* Clone();
 	
 	virtual void WaveUp();
+	
+	virtual void SetSamplingTime(double T);				// change the sampling interval(port resistance is changed)
 };
 
 //============================================================
@@ -145,12 +155,17 @@ public:
 class WDFInductor : public WDFLeaf
 {
 public:
+	double L;				// inductance
 	double T;				// sampling interval
+	double antiDenormal;	// offset added to the stored wave, its sign alternates every sample(0: not used)
 
 	WDFInductor(double L, double T, string lbl="Inductor", WDFType type=WDFType::INDUCTOR);
 	virtual ~WDFInductor();
+	virtual WDFObject* Clone();
 	
 	virtual void WaveUp();
+	
+	virtual void SetSamplingTime(double T);				// change the sampling interval(port resistance is changed)
 };
 
 //============================================================
@@ -163,6 +178,7 @@ public:
 
 	WDFVoltageSource(double Vs, double R, string lbl="VoltageSource", WDFType type=WDFType::VOLTAGE_SOURCE);
 	virtual ~WDFVoltageSource();
+	virtual WDFObject* Clone();
 	
 	virtual void WaveUp();
 };
@@ -175,6 +191,7 @@ class WDFOpenCircuit : public WDFLeaf
 public:
 	WDFOpenCircuit(string lbl="Open Circuit", WDFType type=WDFType::OPEN_CIRCUIT);
 	virtual ~WDFOpenCircuit();
+	virtual WDFObject* Clone();
 	
 	virtual void WaveUp();
 };
@@ -206,6 +223,7 @@ class WDFInverter : public WDFAdaptor
 public:
 	WDFInverter(WDFObject* child, string lbl="Inverter", WDFType type=WDFType::INVERTER);
 	virtual ~WDFInverter();
+	virtual WDFObject* Clone();
 
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
@@ -220,6 +238,7 @@ class WDFIdealTransformer : public WDFAdaptor
 public:
 	WDFIdealTransformer(WDFObject* secondary, double N, string lbl="Ideal Transformer", WDFType type=WDFType::IDEAL_TRANSFORMER);
 	virtual ~WDFIdealTransformer();
+	virtual WDFObject* Clone();
 
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
@@ -237,6 +256,7 @@ class WDFGyrator : public WDFAdaptor
 public:
 	WDFGyrator(WDFObject* child, double R, string lbl="Gyrator", WDFType type=WDFType::GYRATOR);
 	virtual ~WDFGyrator();
+	virtual WDFObject* Clone();
 	
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
@@ -254,6 +274,7 @@ class WDFDualizer : public WDFAdaptor
 public:
 	WDFDualizer(WDFObject* child, bool isInversed=false, string lbl="Dualizer", WDFType type=WDFType::DUALIZER);
 	virtual ~WDFDualizer();
+	virtual WDFObject* Clone();
 	
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
@@ -272,6 +293,7 @@ public:
 	WDFSeries(unsigned int nPorts, string lbl="Series", WDFType type=WDFType::SERIES);
 	WDFSeries(WDFObject* left, WDFObject* right, string lbl="Series", WDFType type=WDFType::SERIES);
 	virtual ~WDFSeries();
+	virtual WDFObject* Clone();
 
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
@@ -287,12 +309,32 @@ public:
 	WDFParallel(unsigned int nPorts, string lbl="Parallel", WDFType type=WDFType::PARALLEL);
 	WDFParallel(WDFObject* left, WDFObject* right, string lbl="Paralel", WDFType type=WDFType::PARALLEL);
 	virtual ~WDFParallel();
+	virtual WDFObject* Clone();
 
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
 	virtual void WaveDown();
 };
 
+//============================================================
+// matrices of R-Type adaptors(shared by the instances until changed)
+//============================================================
+class WDFRTypeMatrices
+{
+public:
+	mat S;		// scattering matrix
+	mat ZIt, ZR, I;
+};
+
+class WDFRTypeNLMatrices
+{
+public:
+	mat S, S11, S12, S21, S22;		// scattering matrices
+	mat C, C11, C12, C21, C22;		// conversion matrices
+	mat p, E, F, M, N;				// K-method
+	mat ZIt, ZR;
+};
+
 //============================================================
 // R-Type (the root adaptor)
 //============================================================
@@ -301,7 +343,9 @@ class WDFRTypeAdaptor : public WDFAdaptor, public MNA
 public:
 	WDFRTypeAdaptor(unsigned int nPorts, unsigned int nChildren, unsigned int nNodes, string lbl="R-Type", WDFType type=WDFType::R_TYPE);
 	virtual ~WDFRTypeAdaptor();
+	virtual WDFObject* Clone();
 
+	virtual void UpdatePortResistance();				// update port resistances, then update the scattering matrix
 	virtual void CalculatePortResistance();
 	virtual void WaveUp();
 	virtual void WaveDown();
@@ -310,15 +354,15 @@ public:
 	virtual void UpdateScatteringMatrix();
 
 protected:
-	mat S;		// scattering matrix
+	CopyOnWrite<WDFRTypeMatrices> matrices;
 	mat a,b;	// wave matrices
-	mat ZIt, ZR, I;
+	MatVecKernel kernelS;	// b = S * a, selected by the number of ports
 };
 
 //============================================================
 // R-Type (nonlinear root adaptor)
 //============================================================
-class WDFRTypeAdaptorNL : public WDFAdaptor, public MNA, public /*Broyden2*/QuasiNewton
+class WDFRTypeAdaptorNL : public WDFAdaptor, public MNA, public NonlinearSystem
 {
 public:
 	/*
@@ -338,7 +382,9 @@ public:
 	WDFRTypeAdaptorNL(WDFObject* left, WDFObject* right, unsigned int nNLs, CircuitModel model, string lbl="R-Type NL");
 	
 	virtual ~WDFRTypeAdaptorNL();
+	virtual WDFObject* Clone();
 	
+	virtual void UpdatePortResistance();				// update port resistances, then update the matrices
 	virtual void CalculatePortResistance();
 	
 	virtual void WaveUp();
@@ -368,13 +414,53 @@ public:
 	 */
 	virtual void UpdateMatrices();
 	
+	/*
+	 Enable or disable the linearized mode. The devices are linearized at the operating point of the last Newton solve,
+	 and the linear update is used while the nonlinear-port voltages stay within vTolerance and the incident waves
+	 stay within aTolerance of the operating point. Otherwise the Newton solve is executed and the devices are linearized again.
+	 */
+	void SetLinearizedMode(bool enable, double vTolerance=1e-3, double aTolerance=1e-1);
+	bool IsLinearizedMode();
+	
+	// the ratio of the samples processed by the linear update
+	double GetLinearizedRatio();
+	
+	// discard the operating point of the previous sample(ADAA & linearization) after the devices are changed
+	void ResetOperatingPoint();
+	
+	/*
+	 Select the solver of the nonlinear ports(Newton by default). The adaptor takes the ownership of the solver.
+	 The solver is prepared again whenever the matrices are updated.
+	 */
+	void SetSolver(NonlinearSolverType type);
+	void SetSolver(NonlinearSolver* solver);
+	NonlinearSolver* GetSolver();
+	
+	// set the limits of the iteration(quality scaling)
+	void SetSolverLimits(int max_iter, double epsilon);
+	
+	/*
+	 Select the predictor of the initial guess(K-method by default). The predictor falls back to the K-method
+	 until the solutions of the previous samples are available.
+	 order: the number of the last solutions extrapolated by the polynomial predictor(1 ~ MAX_PREDICTOR_ORDER)
+	 */
+	void SetPredictor(NonlinearPredictor predictor, unsigned int order=2);
+	NonlinearPredictor GetPredictor();
+	
+	// the system solved by the solver: F(v) = E * a_e + F * i(v) - v, parameterized by p = E * a_e
+	virtual void Evaluate(const double* v_c, double* f);
+	virtual void GetJacobian(const double* v_c, double* J);
+	virtual void EvaluateWithJacobian(const double* v_c, double* f, double* J);
+	virtual unsigned int GetParameterSize();
+	virtual void GetParameter(double* p);
+	virtual void SetParameter(const double* p);
+	virtual void LimitStep(const double* v_old, double* v_new);
+	
 protected:
-	mat S, S11, S12, S21, S22;		// scattering matrices
-	mat C, C11, C12, C21, C22;		// conversion matrices
-	mat p, E, F, M, N;				// K-method
+	CopyOnWrite<WDFRTypeNLMatrices> matrices;
 	vec a_e, b_e;					// wave vectors
 	vec i_c_prev;					// previous current values
-	mat ZIt, ZR;
+	MatVecKernel kernelE, kernelF, kernelM, kernelN;	// the products of K-method, selected by the number of ports
 	
 	CircuitModel model;				// model of the root(parallel, series, ...)
 	unsigned int nNLs;				// the number of nonlinear ports
@@ -382,20 +468,64 @@ protected:
 	// create matrices(scattering & conversion)
 	virtual void CreateMatrices(unsigned int nNLs, unsigned int nSubTrees);
 	
-	// Newton-Raphson evaluation function (F(x) = 0)
+	// evaluation function (F(x) = 0)
 	virtual vec Evaluate(vec v_c);
 	
-	// Newton-Raphson Jacobian matrix calculation
+	// Jacobian matrix of the evaluation function
 	virtual mat GetJacobian(vec v_c);
 	
+	NonlinearSolverPtr solver;		// the solver of the nonlinear ports
+	int solverMaxIter;				// the maximum number of iterations
+	double solverEpsilon;			// the norm of the step at which the iteration stops
+	
+	NonlinearPredictor predictor;	// the initial guess of the solver
+	unsigned int predictorOrder;	// the number of the solutions extrapolated by the polynomial predictor
+	mat vHistory;					// the last solutions(column k: k + 1 samples ago)
+	unsigned int nHistory;			// the number of the valid columns of vHistory
+	vec pPrev;						// E * a_e of the previous solve
+	
+	void Predict(double* v_c);				// the guess of the solver(E * a_e is in pWork)
+	void PushSolution(const double* v_c);	// save the solution for the predictor
+	
 	// Nonlinear function (f:v -> i)
 	virtual vec Nonlinear(vec v_c);
 	
+	// Jacobian matrix of the nonlinear function (di/dv)
+	virtual mat DiffNonlinear(vec v_c);
+	
+	// in-place versions of the above(no allocation), used by the per-sample path
+	void Nonlinear(const double* v_c, double* i_c);
+	void DiffNonlinear(const double* v_c, double* dI);
+	void NonlinearWithJacobian(const double* v_c, double* i_c, double* dI);
+	void AssembleJacobian(const double* dI, double* J);		// J = F * dI - I
+	
+	// preallocated workspace of the per-sample path(sized by CreateMatrices)
+	vec vWork, iWork, iOutWork;		// voltages & currents of the nonlinear ports
+	vec pWork;						// E * a_e, constant during the iteration
+	mat dIWork;						// Jacobian of the nonlinear function
+	mat KWork;						// I - F * J of the linearization(factorized)
+	vec tWork;						// temporary of the linearization
+	std::vector<unsigned int> pivotWork;
+	
 	// the flag value whether the iteration is first process
 	bool bFirstWave;
 	
 	// update the values of nonlinear elements
-	void UpdateNonlinearValues(vec Vprev, vec Iprev);
+	void UpdateNonlinearValues(const double* Vprev, const double* Iprev);
+	
+	// antiderivative anti-aliasing of the one-port nonlinearity(i = h(p), p = E * a_e)
+	double AntialiasCurrent(WDFRTypeRootLeaf* leaf, double v, double i);
+	bool bValidADAA;				// true if the values of the previous sample are valid
+	double p_prev, H_prev, i_prev;	// the values of the previous sample
+	
+	// linearized mode: v = P * a_e + q, i = i_lin + J_lin * (v - v_lin)
+	void Linearize(const double* v_c, const double* i_c);
+	bool bLinearized;				// true if the linearized mode is enabled
+	bool bValidLinear;				// true if the operating point is valid
+	double vTolerance, aTolerance;	// the size of the region in which the linearization is used
+	mat P_lin, J_lin;
+	vec q_lin, v_lin, i_lin, a_lin;	// the operating point
+	unsigned int nLinearSamples, nTotalSamples;
 };
 
 //============================================================
@@ -447,8 +577,29 @@ public:
 	virtual vec Nonlinear(vec Vc) = 0;					// calculate Ic fed to the root(Ic = F(Vc))
 	virtual mat DiffNonlinear(vec Vc) = 0;				// calculate Jacobian matrix
 	
+	// allocation-free versions called by the root in the per-sample path(the vec versions are called by default)
+	// Vc, Ic: the values of the ports, J: the Jacobian stored in column-major order with the leading dimension ld
+	// by default the argument is passed in a workspace, but the result of the vec version is allocated by armadillo above 16 values(4 ports for the Jacobian)
+	virtual void Nonlinear(const double* Vc, double* Ic);
+	virtual void DiffNonlinear(const double* Vc, double* J, unsigned int ld);
+	virtual void UpdateValues(const double* Vprev, const double* Iprev);
+	
+	// Ic & J at once, so the terms shared by both(exp, log, pow) are evaluated once per iteration
+	// Nonlinear & DiffNonlinear are called by default
+	virtual void NonlinearWithJacobian(const double* Vc, double* Ic, double* J, unsigned int ld);
+	
+	// limit the Newton step of the port voltages in place(pn-junction limiting), nothing by default
+	virtual void LimitVoltage(const double* Vold, double* Vnew);
+	
+	virtual bool IsAntialiased();						// true if the antiderivative of the one-port current is given(ADAA)
+	virtual double Antiderivative(double Vc);			// the antiderivative of the one-port current
+	
 protected:
 	vec Vprev, Iprev;		// variables for reactances
+	vec vWork;				// the memory of the argument of the vec versions called by default
+	
+	// SPICE pn-junction limiting(nVt: the emission coefficient times the thermal voltage, vCrit: the critical voltage)
+	static double LimitJunctionVoltage(double vNew, double vOld, double nVt, double vCrit);
 };
 
 #endif	//WDF_HPP
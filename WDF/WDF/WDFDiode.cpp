@@ -8,6 +8,8 @@
 
 #include <cmath>
 #include "WDFDiode.hpp"
+#include "Dual.hpp"
+#include "WrightOmega.hpp"
 
 //============================================================
 // Diode (symmetric)
@@ -24,18 +26,37 @@ WDFDiode::~WDFDiode()
 	
 }
 
+WDFObject* WDFDiode::Clone()
+{
+	return new WDFDiode(*this);
+}
+
 void WDFDiode::EvaluateReflectedWave()
 {
-	vecPorts[0]->b = Solve(0);
+	vecPorts[0]->b = Solve(GetGuess(0), solverMaxIter, solverEpsilon);
 }
 
-double WDFDiode::Evaluate(double b)
+template<typename T>
+T WDFDiode::Residual(const T& b) const
 {
 	// I = 2*Is*sinh(V/(Ne*Vt))
-	WDFPort* port = vecPorts[0];
+	const WDFPort* port = vecPorts[0];
 	return 2.0 * Is * sinh((port->a + b) / (2 * Ne * Vt)) - (port->a - b) / (2.0 * port->Rp);
 }
 
+double WDFDiode::Evaluate(double b)
+{
+	return Residual(b);
+}
+
+bool WDFDiode::EvaluateWithDerivative(double b, double& f, double& df)
+{
+	const Dual<1> r = Residual(Dual<1>::Variable(b, 0));
+	f = r.v;
+	df = r.d[0];
+	return true;
+}
+
 //============================================================
 // Diode (asymmetric, R-Type)
 //============================================================
@@ -52,26 +73,58 @@ WDFRTypeAsymDiode::~WDFRTypeAsymDiode()
 	
 }
 
+WDFObject* WDFRTypeAsymDiode::Clone()
+{
+	return new WDFRTypeAsymDiode(*this);
+}
+
 vec WDFRTypeAsymDiode::Nonlinear(vec v_c)
 {
-	// Aymmetric diode is just a one-port
-	double Vc = v_c(0);
 	vec i_c(1);
-	i_c(0) = isInverse ? -Is * (exp(-Vc / (Ne * Vt)) - 1) : Is * (exp(Vc / (Ne * Vt)) - 1);
-	
+	Nonlinear(v_c.memptr(), i_c.memptr());
 	return i_c;
 }
 
 mat WDFRTypeAsymDiode::DiffNonlinear(vec v_c)
 {
 	mat J(1,1);
-	
-	double Vc = v_c(0);
-	J(0,0) = isInverse ? Is / (Ne * Vt) * exp(-Vc / (Ne * Vt)) : Is / (Ne * Vt) * exp(Vc / (Ne * Vt));
-	
+	DiffNonlinear(v_c.memptr(), J.memptr(), 1);
 	return J;
 }
 
+void WDFRTypeAsymDiode::Nonlinear(const double* v_c, double* i_c)
+{
+	// Aymmetric diode is just a one-port
+	double Vc = v_c[0];
+	i_c[0] = isInverse ? -Is * (exp(-Vc / (Ne * Vt)) - 1) : Is * (exp(Vc / (Ne * Vt)) - 1);
+}
+
+void WDFRTypeAsymDiode::DiffNonlinear(const double* v_c, double* J, unsigned int ld)
+{
+	double i_c;
+	NonlinearWithJacobian(v_c, &i_c, J, ld);
+}
+
+void WDFRTypeAsymDiode::NonlinearWithJacobian(const double* v_c, double* i_c, double* J, unsigned int ld)
+{
+	// an exp for both
+	const double nVt = Ne * Vt;
+	const double ex = isInverse ? exp(-v_c[0] / nVt) : exp(v_c[0] / nVt);
+	i_c[0] = isInverse ? -Is * (ex - 1) : Is * (ex - 1);
+	J[0] = Is / nVt * ex;
+}
+
+void WDFRTypeAsymDiode::LimitVoltage(const double* Vold, double* Vnew)
+{
+	// the junction is forward biased by -Vc if inverse
+	const double nVt = Ne * Vt;
+	const double vCrit = nVt * log(nVt / (sqrt(2.0) * Is));
+	if(isInverse)
+		Vnew[0] = -LimitJunctionVoltage(-Vnew[0], -Vold[0], nVt, vCrit);
+	else
+		Vnew[0] = LimitJunctionVoltage(Vnew[0], Vold[0], nVt, vCrit);
+}
+
 //============================================================
 // Diode (symmetric, R-Type)
 //============================================================
@@ -87,22 +140,271 @@ WDFRTypeDiode::~WDFRTypeDiode()
 	
 }
 
+WDFObject* WDFRTypeDiode::Clone()
+{
+	return new WDFRTypeDiode(*this);
+}
+
 vec WDFRTypeDiode::Nonlinear(vec v_c)
 {
-	// Symmetric diode is just a one-port
-	double Vc = v_c(0);
 	vec i_c(1);
-	i_c(0) = Is * (exp(Vc / (Ne * Vt)) - exp(-Vc / (Ne * Vt)));
-	
+	Nonlinear(v_c.memptr(), i_c.memptr());
 	return i_c;
 }
 
 mat WDFRTypeDiode::DiffNonlinear(vec v_c)
 {
 	mat J(1,1);
+	DiffNonlinear(v_c.memptr(), J.memptr(), 1);
+	return J;
+}
+
+void WDFRTypeDiode::Nonlinear(const double* v_c, double* i_c)
+{
+	// Symmetric diode is just a one-port
+	double Vc = v_c[0];
+	i_c[0] = Is * (exp(Vc / (Ne * Vt)) - exp(-Vc / (Ne * Vt)));
+}
+
+void WDFRTypeDiode::DiffNonlinear(const double* v_c, double* J, unsigned int ld)
+{
+	double i_c;
+	NonlinearWithJacobian(v_c, &i_c, J, ld);
+}
+
+void WDFRTypeDiode::NonlinearWithJacobian(const double* v_c, double* i_c, double* J, unsigned int ld)
+{
+	// exp(-x) = 1 / exp(x)
+	const double nVt = Ne * Vt;
+	const double ex = exp(v_c[0] / nVt);
+	const double exInv = 1.0 / ex;
+	i_c[0] = Is * (ex - exInv);
+	J[0] = Is / nVt * (ex + exInv);
+}
+
+void WDFRTypeDiode::LimitVoltage(const double* Vold, double* Vnew)
+{
+	// one of the antiparallel junctions is forward biased by the sign of Vc
+	const double nVt = Ne * Vt;
+	const double vCrit = nVt * log(nVt / (sqrt(2.0) * Is));
+	if(Vnew[0] >= 0.0)
+		Vnew[0] = LimitJunctionVoltage(Vnew[0], Vold[0], nVt, vCrit);
+	else
+		Vnew[0] = -LimitJunctionVoltage(-Vnew[0], -Vold[0], nVt, vCrit);
+}
+
+//============================================================
+// Diode (symmetric, 1st-order antiderivative anti-aliasing)
+//============================================================
+WDFDiodeADAA::WDFDiodeADAA(double Is, double Vt, double Ne, string label) : WDFDiode(Is, Vt, Ne, label)
+{
+	tolerance = 1e-5;
+	Reset();
+}
+
+WDFDiodeADAA::~WDFDiodeADAA()
+{
+	
+}
+
+WDFObject* WDFDiodeADAA::Clone()
+{
+	return new WDFDiodeADAA(*this);
+}
+
+void WDFDiodeADAA::Reset()
+{
+	bFirst = true;
+	aPrev = bPrev = FPrev = RPrev = 0.0;
+}
+
+void WDFDiodeADAA::EvaluateReflectedWave()
+{
+	WDFPort* port = vecPorts[0];
+	const double a = port->a;
+	const double R = port->Rp;
 	
-	double Vc = v_c(0);
-	J(0,0) = Is / (Ne * Vt) * (exp(Vc / (Ne * Vt)) + exp(-Vc / (Ne * Vt)));
+	// the static wave mapping b = f(a)
+	const double b = Solve(GetGuess(0), solverMaxIter, solverEpsilon);
+	const double v = (a + b) / 2.0;
+	const double i = (a - b) / (2.0 * R);
+	const double F = Antiderivative(v, i, R);
 	
-	return J;
+	// b[n] = (F(a[n]) - F(a[n-1])) / (a[n] - a[n-1])
+	if(bFirst || R != RPrev)
+		port->b = b;							// no valid previous sample
+	else if(fabs(a - aPrev) < tolerance)
+		port->b = 0.5 * (b + bPrev);			// ill-conditioned, use the average
+	else
+		port->b = (F - FPrev) / (a - aPrev);
+	
+	bFirst = false;
+	aPrev = a;
+	bPrev = b;
+	FPrev = F;
+	RPrev = R;
+}
+
+double WDFDiodeADAA::Antiderivative(double v, double i, double R)
+{
+	// a = v + R*i, b = v - R*i, I(v) = 2*Is*sinh(v/(Ne*Vt))
+	// F = v^2/2 + R*v*i - 2*R*(integral of I dv) - R^2*i^2/2
+	// the integral is 2*Is*Ne*Vt*(cosh(v/(Ne*Vt)) - 1), and cosh(x) - 1 = 2*sinh^2(x/2)
+	const double nVt = Ne * Vt;
+	const double s = sinh(v / (2.0 * nVt));
+	const double G = 4.0 * Is * nVt * s * s;
+	
+	return 0.5 * v * v + R * v * i - 2.0 * R * G - 0.5 * R * R * i * i;
+}
+
+//============================================================
+// Diode (asymmetric, R-Type, 1st-order antiderivative anti-aliasing)
+//============================================================
+WDFRTypeAsymDiodeADAA::WDFRTypeAsymDiodeADAA(double Is, double Vt, double Ne, bool isInverse, string label) : WDFRTypeAsymDiode(Is, Vt, Ne, isInverse, label)
+{
+	
+}
+
+WDFRTypeAsymDiodeADAA::~WDFRTypeAsymDiodeADAA()
+{
+	
+}
+
+WDFObject* WDFRTypeAsymDiodeADAA::Clone()
+{
+	return new WDFRTypeAsymDiodeADAA(*this);
+}
+
+bool WDFRTypeAsymDiodeADAA::IsAntialiased()
+{
+	return true;
+}
+
+double WDFRTypeAsymDiodeADAA::Antiderivative(double Vc)
+{
+	// G(v) = Is*(Ne*Vt*(exp(v/(Ne*Vt)) - 1) - v), or Is*(Ne*Vt*(exp(-v/(Ne*Vt)) - 1) + v) if inverse
+	// the constant keeps the values small around 0
+	const double nVt = Ne * Vt;
+	return isInverse ? Is * (nVt * expm1(-Vc / nVt) + Vc) : Is * (nVt * expm1(Vc / nVt) - Vc);
+}
+
+//============================================================
+// Diode (symmetric, R-Type, 1st-order antiderivative anti-aliasing)
+//============================================================
+WDFRTypeDiodeADAA::WDFRTypeDiodeADAA(double Is, double Vt, double Ne, string label) : WDFRTypeDiode(Is, Vt, Ne, label)
+{
+	
+}
+
+WDFRTypeDiodeADAA::~WDFRTypeDiodeADAA()
+{
+	
+}
+
+WDFObject* WDFRTypeDiodeADAA::Clone()
+{
+	return new WDFRTypeDiodeADAA(*this);
+}
+
+bool WDFRTypeDiodeADAA::IsAntialiased()
+{
+	return true;
+}
+
+double WDFRTypeDiodeADAA::Antiderivative(double Vc)
+{
+	// G(v) = 2*Is*Ne*Vt*(cosh(v/(Ne*Vt)) - 1), and cosh(x) - 1 = 2*sinh^2(x/2)
+	const double s = sinh(Vc / (2.0 * Ne * Vt));
+	return 4.0 * Is * Ne * Vt * s * s;
+}
+
+//============================================================
+// Diode (asymmetric, explicit by Wright omega function)
+//============================================================
+WDFExplicitDiode::WDFExplicitDiode(double Is, double Vt, double Ne, bool isInverse, string label) : WDFRootLeaf(label)
+{
+	this->Is = Is;
+	this->Vt = Vt;
+	this->Ne = Ne;
+	this->isInverse = isInverse;
+	
+	RPrev = 0.0;
+	logRIs = 0.0;
+}
+
+WDFExplicitDiode::~WDFExplicitDiode()
+{
+	
+}
+
+WDFObject* WDFExplicitDiode::Clone()
+{
+	return new WDFExplicitDiode(*this);
+}
+
+void WDFExplicitDiode::EvaluateReflectedWave()
+{
+	WDFPort* port = vecPorts[0];
+	port->b = ReflectedWave(port->a, isInverse ? -1.0 : 1.0);
+}
+
+double WDFExplicitDiode::ReflectedWave(double a, double sign)
+{
+	//============================================================
+	// (a - b)/(2R) = Is*(exp((a + b)/(2*Ne*Vt)) - 1) is solved by
+	// b = a + 2*R*Is - 2*Ne*Vt*omega(log(R*Is/(Ne*Vt)) + (a + R*Is)/(Ne*Vt))
+	// the inverse diode is the same with a -> -a, b -> -b
+	//============================================================
+	const double R = vecPorts[0]->Rp;
+	const double nVt = Ne * Vt;
+	if(R != RPrev)
+	{
+		logRIs = log(R * Is / nVt);
+		RPrev = R;
+	}
+	
+	const double as = sign * a;
+	return sign * (as + 2.0 * R * Is - 2.0 * nVt * WrightOmega(logRIs + (as + R * Is) / nVt));
+}
+
+//============================================================
+// Diode (symmetric, explicit by Wright omega function)
+//============================================================
+WDFExplicitDiodePair::WDFExplicitDiodePair(double Is, double Vt, double Ne, string label) : WDFExplicitDiode(Is, Vt, Ne, false, label)
+{
+	bRefine = false;
+}
+
+WDFExplicitDiodePair::~WDFExplicitDiodePair()
+{
+	
+}
+
+WDFObject* WDFExplicitDiodePair::Clone()
+{
+	return new WDFExplicitDiodePair(*this);
+}
+
+void WDFExplicitDiodePair::SetRefinement(bool enable)
+{
+	bRefine = enable;
+}
+
+void WDFExplicitDiodePair::EvaluateReflectedWave()
+{
+	// the forward biased diode of the pair
+	WDFPort* port = vecPorts[0];
+	const double a = port->a;
+	double b = ReflectedWave(a, a < 0.0 ? -1.0 : 1.0);
+	
+	if(bRefine)
+	{
+		// f(b) = 2*Is*sinh((a + b)/(2*Ne*Vt)) - (a - b)/(2R), sinh & cosh by one exp
+		const double e = exp((a + b) / (2.0 * Ne * Vt));
+		const double f = Is * (e - 1.0 / e) - (a - b) / (2.0 * port->Rp);
+		const double df = Is / (2.0 * Ne * Vt) * (e + 1.0 / e) + 1.0 / (2.0 * port->Rp);
+		b -= f / df;
+	}
+	
+	port->b = b;
 }
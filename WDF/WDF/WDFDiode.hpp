@@ -19,6 +19,7 @@ class WDFDiode : public WDFRootLeaf, public NewtonRaphson
 public:
 	WDFDiode(double Is, double Vt, double Ne, string label="Diode");
 	~WDFDiode();
+	virtual WDFObject* Clone();
 	
 	virtual void EvaluateReflectedWave();
 	
@@ -28,6 +29,10 @@ protected:
 	
 	// Newton-Raphson iteration
 	virtual double Evaluate(double x);
+	virtual bool EvaluateWithDerivative(double x, double& f, double& df);
+	
+	// the residual of the port by b, T is double or Dual(the derivative)
+	template<typename T> T Residual(const T& b) const;
 };
 
 //============================================================
@@ -38,9 +43,14 @@ class WDFRTypeAsymDiode : public WDFRTypeRootLeaf
 public:
 	WDFRTypeAsymDiode(double Is, double Vt, double Ne, bool isInverse, string label="R-Type Asymmetric Diode");
 	~WDFRTypeAsymDiode();
+	virtual WDFObject* Clone();
 	
 	virtual vec Nonlinear(vec v_c);
 	virtual mat DiffNonlinear(vec v_c);
+	virtual void Nonlinear(const double* v_c, double* i_c);
+	virtual void DiffNonlinear(const double* v_c, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* v_c, double* i_c, double* J, unsigned int ld);
+	virtual void LimitVoltage(const double* Vold, double* Vnew);
 	
 protected:
 	// diode parameters
@@ -57,13 +67,114 @@ class WDFRTypeDiode : public WDFRTypeRootLeaf
 public:
 	WDFRTypeDiode(double Is, double Vt, double Ne, string label="R-Type Diode");
 	~WDFRTypeDiode();
+	virtual WDFObject* Clone();
 	
 	virtual vec Nonlinear(vec v_c);
 	virtual mat DiffNonlinear(vec v_c);
+	virtual void Nonlinear(const double* v_c, double* i_c);
+	virtual void DiffNonlinear(const double* v_c, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* v_c, double* i_c, double* J, unsigned int ld);
+	virtual void LimitVoltage(const double* Vold, double* Vnew);
 	
 protected:
 	// diode parameters
 	double Is, Vt, Ne;
 };
 
+//============================================================
+// Diode (symmetric, 1st-order antiderivative anti-aliasing)
+//============================================================
+class WDFDiodeADAA : public WDFDiode
+{
+public:
+	WDFDiodeADAA(double Is, double Vt, double Ne, string label="Diode ADAA");
+	~WDFDiodeADAA();
+	virtual WDFObject* Clone();
+	
+	virtual void EvaluateReflectedWave();
+	
+	void Reset();						// forget the previous sample
+	
+	double tolerance;					// if |a[n] - a[n-1]| is smaller than this, the average is used
+	
+protected:
+	double Antiderivative(double v, double i, double R);	// F(a) = integral of b(a) da, expressed by v & i
+	
+	bool bFirst;						// true until the first sample is processed
+	double aPrev, bPrev, FPrev, RPrev;	// the values of the previous sample
+};
+
+//============================================================
+// Diode (asymmetric, R-Type, 1st-order antiderivative anti-aliasing)
+//============================================================
+class WDFRTypeAsymDiodeADAA : public WDFRTypeAsymDiode
+{
+public:
+	WDFRTypeAsymDiodeADAA(double Is, double Vt, double Ne, bool isInverse, string label="R-Type Asymmetric Diode ADAA");
+	~WDFRTypeAsymDiodeADAA();
+	virtual WDFObject* Clone();
+	
+	virtual bool IsAntialiased();
+	virtual double Antiderivative(double Vc);
+};
+
+//============================================================
+// Diode (symmetric, R-Type, 1st-order antiderivative anti-aliasing)
+//============================================================
+class WDFRTypeDiodeADAA : public WDFRTypeDiode
+{
+public:
+	WDFRTypeDiodeADAA(double Is, double Vt, double Ne, string label="R-Type Diode ADAA");
+	~WDFRTypeDiodeADAA();
+	virtual WDFObject* Clone();
+	
+	virtual bool IsAntialiased();
+	virtual double Antiderivative(double Vc);
+};
+
+//============================================================
+// Diode (asymmetric, explicit by Wright omega function)
+//============================================================
+class WDFExplicitDiode : public WDFRootLeaf
+{
+public:
+	WDFExplicitDiode(double Is, double Vt, double Ne, bool isInverse=false, string label="Explicit Diode");
+	~WDFExplicitDiode();
+	virtual WDFObject* Clone();
+	
+	virtual void EvaluateReflectedWave();
+	
+protected:
+	// b of the forward diode for the sign(-1: the inverse) of the incident wave, no iteration
+	double ReflectedWave(double a, double sign);
+	
+	// diode parameters
+	double Is, Vt, Ne;
+	
+	bool isInverse;	// inverse, or not
+	
+	double RPrev, logRIs;	// log(R*Is/(Ne*Vt)) for the port resistance RPrev
+};
+
+//============================================================
+// Diode (symmetric, explicit by Wright omega function)
+// The reverse biased diode is neglected, so |b| is off by < 0.5mV at most for Rp < 100k
+// unless it is refined.
+//============================================================
+class WDFExplicitDiodePair : public WDFExplicitDiode
+{
+public:
+	WDFExplicitDiodePair(double Is, double Vt, double Ne, string label="Explicit Diode Pair");
+	~WDFExplicitDiodePair();
+	virtual WDFObject* Clone();
+	
+	virtual void EvaluateReflectedWave();
+	
+	// one Newton step on the exact equation(2*Is*sinh) after the explicit solution
+	void SetRefinement(bool enable);
+	
+protected:
+	bool bRefine;
+};
+
 #endif /* WDFDiode_hpp */
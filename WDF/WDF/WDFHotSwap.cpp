@@ -0,0 +1,173 @@
+//
+//  WDFHotSwap.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 24..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <memory>
+#include "WDFHotSwap.hpp"
+
+/**
+ the size of the blocks processed during the crossfade
+ */
+#define CROSSFADE_BLOCK_SIZE	64
+
+WDFHotSwap::WDFHotSwap(WDFTree* tree) : pending(NULL), retired(NULL), bBusy(false)
+{
+	current = tree;
+	fading = NULL;
+	nFadeSamples = 0;
+	iFadeSample = 0;
+	nPendingFadeSamples = 0;
+	bPendingTransfer = false;
+}
+
+WDFHotSwap::~WDFHotSwap()
+{
+	delete current;
+	delete fading;
+	delete pending.load();
+	delete retired.load();
+}
+
+future<WDFTree*> WDFHotSwap::Compile(Graph* graph, SPQRTreeTransform transform, float fSamplingTime, unsigned int nOversampling, WDFEngine engine)
+{
+	// Copy on the calling thread, then the caller can change the graph
+	shared_ptr<Graph> copied(new Graph(graph));
+	
+	return async(launch::async, [copied, transform, fSamplingTime, nOversampling, engine]()
+	{
+		SPQRTree spqrTree;
+		copied->MakeSPQRTree(&spqrTree);
+		if(transform)
+			transform(&spqrTree);
+		
+		return spqrTree.CreateWDFTree(fSamplingTime, nOversampling, engine);
+	});
+}
+
+bool WDFHotSwap::Swap(WDFTree* tree, unsigned int nCrossfadeSamples, bool bTransferStates)
+{
+	if(!tree || bBusy.load(memory_order_acquire))
+		return false;
+	
+	Collect();
+	
+	// The settings are read by the audio thread after the tree is published
+	nPendingFadeSamples = nCrossfadeSamples;
+	bPendingTransfer = bTransferStates;
+	bBusy.store(true, memory_order_relaxed);
+	pending.store(tree, memory_order_release);
+	
+	return true;
+}
+
+bool WDFHotSwap::Swap(future<WDFTree*> &compiled, unsigned int nCrossfadeSamples, bool bTransferStates)
+{
+	if(!compiled.valid() || compiled.wait_for(chrono::seconds(0)) != future_status::ready)
+		return false;
+	if(bBusy.load(memory_order_acquire))
+		return false;
+	
+	return Swap(compiled.get(), nCrossfadeSamples, bTransferStates);
+}
+
+bool WDFHotSwap::IsSwapping()
+{
+	return bBusy.load(memory_order_acquire);
+}
+
+void WDFHotSwap::Collect()
+{
+	delete retired.exchange(NULL, memory_order_acq_rel);
+}
+
+void WDFHotSwap::BeginSwap()
+{
+	WDFTree* next = pending.load(memory_order_acquire);
+	
+	// Read the settings before releasing the slot
+	const unsigned int nFade = nPendingFadeSamples;
+	if(bPendingTransfer && current)
+		next->TransferStates(current);
+	pending.store(NULL, memory_order_release);
+	
+	fading = current;
+	current = next;
+	
+	if(fading && nFade > 0)
+	{
+		nFadeSamples = nFade;
+		iFadeSample = 0;
+	}
+	else
+	{
+		EndSwap();
+	}
+}
+
+void WDFHotSwap::EndSwap()
+{
+	retired.store(fading, memory_order_release);
+	fading = NULL;
+	bBusy.store(false, memory_order_release);
+}
+
+void WDFHotSwap::Process(const float* in, float* out, unsigned int nSamples)
+{
+	if(pending.load(memory_order_acquire))
+		BeginSwap();
+	
+	if(!current)
+	{
+		for(unsigned int i=0; i<nSamples; i++)
+			out[i] = 0.0f;
+		return;
+	}
+	
+	if(!fading)
+	{
+		current->Process(in, out, nSamples);
+		return;
+	}
+	
+	//============================================================
+	// Crossfade: both trees are processed, then mixed linearly
+	//============================================================
+	float input[CROSSFADE_BLOCK_SIZE], old[CROSSFADE_BLOCK_SIZE];
+	unsigned int i = 0;
+	while(i < nSamples && fading)
+	{
+		const unsigned int n = min(nSamples - i, (unsigned int)CROSSFADE_BLOCK_SIZE);
+		
+		// The output can be same as the input
+		for(unsigned int j=0; j<n; j++)
+			input[j] = in[i + j];
+		
+		fading->Process(input, old, n);
+		current->Process(input, &out[i], n);
+		
+		for(unsigned int j=0; j<n; j++)
+		{
+			const float gain = (iFadeSample < nFadeSamples) ? (float)(iFadeSample + 1) / nFadeSamples : 1.0f;
+			out[i + j] = old[j] + gain * (out[i + j] - old[j]);
+			iFadeSample++;
+		}
+		
+		if(iFadeSample >= nFadeSamples)
+			EndSwap();
+		
+		i += n;
+	}
+	
+	// The rest of the block after the crossfade
+	if(i < nSamples)
+		current->Process(&in[i], &out[i], nSamples - i);
+}
+
+WDFTree* WDFHotSwap::GetTree()
+{
+	return current;
+}
@@ -0,0 +1,145 @@
+//
+//  WDFHotSwap.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 24..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WDFHotSwap_hpp
+#define WDFHotSwap_hpp
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include "Graph.hpp"
+
+/**
+ A function which transforms the SPQR tree made from the graph(binary tree, rigid root, nonlinear elements, ...) before it's converted to the WDF tree
+ */
+typedef function<void(SPQRTree*)> SPQRTreeTransform;
+
+/**
+ A class that holds the running WDF tree and replaces it without blocking the audio thread. A new tree is compiled from a graph on a background thread, then swapped at the start of a block. The old tree keeps running during the crossfade, and it's deleted on the control thread later.
+ 
+ Process is called only by the audio thread, and Swap & Collect only by one control thread.
+ */
+class WDFHotSwap
+{
+public:
+	/**
+	 Create a holder
+	 
+	 @param tree the tree which runs first, or NULL(silence). It's owned by the holder.
+	 */
+	WDFHotSwap(WDFTree* tree=NULL);
+	~WDFHotSwap();
+	
+	/**
+	 Compile a graph to a WDF tree on a background thread. The graph is copied before returning, so it can be edited or deleted afterwards. Keep the future until the tree is taken, because destroying it waits for the compilation.
+	 
+	 @param graph the circuit
+	 @param transform the transformations of the SPQR tree. It's called on the background thread.
+	 @param fSamplingTime sampling period
+	 @param nOversampling oversampling factor(1, 2, 4 or 8)
+	 @param engine the engine of the tree
+	 @return the future of the new tree. An exception of the compilation is thrown by get().
+	 */
+	static future<WDFTree*> Compile(Graph* graph, SPQRTreeTransform transform, float fSamplingTime, unsigned int nOversampling=1, WDFEngine engine=WDFEngine::WAVE);
+	
+	/**
+	 Replace the running tree at the start of the next block
+	 
+	 @param tree the new tree. It's owned by the holder.
+	 @param nCrossfadeSamples the length of the linear crossfade from the old tree. 0 switches at once.
+	 @param bTransferStates true if the new tree takes over the states of the old one(see WDFTree::TransferStates)
+	 @return false if the previous swap hasn't finished yet(the tree is not taken)
+	 */
+	bool Swap(WDFTree* tree, unsigned int nCrossfadeSamples=0, bool bTransferStates=true);
+	
+	/**
+	 Replace the running tree by a compiled tree if the compilation has finished. It never waits, so it can be polled from a timer.
+	 
+	 @param compiled the future returned by Compile
+	 @param nCrossfadeSamples the length of the linear crossfade from the old tree
+	 @param bTransferStates true if the new tree takes over the states of the old one
+	 @return true if the tree is taken from the future
+	 */
+	bool Swap(future<WDFTree*> &compiled, unsigned int nCrossfadeSamples=0, bool bTransferStates=true);
+	
+	/**
+	 Check whether a swap is waiting or crossfading
+	 
+	 @return true if the previous swap hasn't finished
+	 */
+	bool IsSwapping();
+	
+	/**
+	 Delete the old tree after the swap has finished. Swap calls it, so call it only to release the memory earlier.
+	 */
+	void Collect();
+	
+	/**
+	 Process a block by the running tree(audio thread only)
+	 
+	 @param in input voltages
+	 @param out output voltages. It can be same as the input.
+	 @param nSamples the number of samples in the block
+	 */
+	void Process(const float* in, float* out, unsigned int nSamples);
+	
+	/**
+	 Get the running tree. Use it on the audio thread, or while the holder is not processed.
+	 
+	 @return the running tree
+	 */
+	WDFTree* GetTree();
+	
+private:
+	WDFHotSwap(const WDFHotSwap&);
+	WDFHotSwap& operator=(const WDFHotSwap&);
+	
+	/**
+	 Take the waiting tree(audio thread)
+	 */
+	void BeginSwap();
+	
+	/**
+	 Hand the old tree to the control thread(audio thread)
+	 */
+	void EndSwap();
+	
+	/**
+	 the running tree(audio thread)
+	 */
+	WDFTree* current;
+	
+	/**
+	 the old tree during the crossfade(audio thread)
+	 */
+	WDFTree* fading;
+	
+	/**
+	 the length & the position of the crossfade(audio thread)
+	 */
+	unsigned int nFadeSamples, iFadeSample;
+	
+	/**
+	 the tree waiting for the swap. The settings of the swap are written before it's published.
+	 */
+	atomic<WDFTree*> pending;
+	unsigned int nPendingFadeSamples;
+	bool bPendingTransfer;
+	
+	/**
+	 the old tree to be deleted by the control thread
+	 */
+	atomic<WDFTree*> retired;
+	
+	/**
+	 true from Swap until the old tree is retired
+	 */
+	atomic<bool> bBusy;
+};
+
+#endif /* WDFHotSwap_hpp */
@@ -0,0 +1,106 @@
+//
+//  WDFParameter.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 23..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include "WDFParameter.hpp"
+#include "WDFTube.hpp"
+
+WDFParameterQueue::WDFParameterQueue(unsigned int capacity, bool bMultiProducer)
+{
+	this->capacity = capacity;
+	spsc = NULL;
+	mpsc = NULL;
+	
+	if(bMultiProducer)
+		mpsc = new MPSCRingBuffer<WDFParameter>(capacity);
+	else
+		spsc = new RingBuffer<WDFParameter>(capacity);
+}
+
+WDFParameterQueue::~WDFParameterQueue()
+{
+	delete spsc;
+	delete mpsc;
+}
+
+bool WDFParameterQueue::Post(const WDFParameter &param)
+{
+	if(mpsc)
+		return mpsc->Push(param);
+	return spsc->Push(&param, 1);
+}
+
+bool WDFParameterQueue::Take(WDFParameter &param)
+{
+	if(mpsc)
+		return mpsc->Pop(param);
+	return spsc->Pop(&param, 1);
+}
+
+unsigned int WDFParameterQueue::GetCapacity()
+{
+	return capacity;
+}
+
+bool WDFParameterQueue::IsMultiProducer()
+{
+	return mpsc != NULL;
+}
+
+bool WDFParameterQueue::Apply(const WDFParameter &param, double T)
+{
+	WDFObject* target = param.target;
+	if(!target)
+		return false;
+	
+	switch(param.type)
+	{
+		case WDFParameterType::RESISTANCE:
+			if((target->type != WDFType::RESISTOR && target->type != WDFType::VOLTAGE_SOURCE) || param.value <= 0.0)
+				return false;
+			target->vecPorts[RFP]->Rp = param.value;
+			target->vecPorts[RFP]->Gp = 1.0 / param.value;
+			return true;
+			
+		case WDFParameterType::CAPACITANCE:
+			if(target->type != WDFType::CAPACITOR || param.value <= 0.0)
+				return false;
+			((WDFCapacitor*)target)->C = param.value;
+			((WDFCapacitor*)target)->SetSamplingTime(T);
+			return true;
+			
+		case WDFParameterType::INDUCTANCE:
+			if(target->type != WDFType::INDUCTOR || param.value <= 0.0)
+				return false;
+			((WDFInductor*)target)->L = param.value;
+			((WDFInductor*)target)->SetSamplingTime(T);
+			return true;
+			
+		case WDFParameterType::VOLTAGE:
+			if(target->type == WDFType::VOLTAGE_SOURCE)
+				((WDFVoltageSource*)target)->Vs = param.value;
+			return false;
+			
+		case WDFParameterType::TUBE_MODEL:
+		{
+			NormanKoren* tube = dynamic_cast<NormanKoren*>(target);
+			if(tube)
+				tube->SetTubeModel((TubeModel)(int)param.value);
+			return false;
+		}
+			
+		case WDFParameterType::PENTODE_MODE:
+		{
+			WDFRTypeNKPentode* pentode = dynamic_cast<WDFRTypeNKPentode*>(target);
+			if(pentode)
+				pentode->SetMode((PentodeMode)(int)param.value);
+			return false;
+		}
+	}
+	
+	return false;
+}
@@ -0,0 +1,126 @@
+//
+//  WDFParameter.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 23..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WDFParameter_hpp
+#define WDFParameter_hpp
+
+#include "WDF.hpp"
+#include "RingBuffer.hpp"
+
+/**
+ The kind of the value changed by a parameter message
+ */
+enum class WDFParameterType
+{
+	RESISTANCE,		// resistance of a resistor or the internal resistance of a voltage source(other targets are rejected)
+	CAPACITANCE,	// capacitance of a capacitor
+	INDUCTANCE,		// inductance of an inductor
+	VOLTAGE,		// voltage of a voltage source
+	TUBE_MODEL,		// TubeModel of a Norman Koren tube
+	PENTODE_MODE	// PentodeMode of a pentode
+};
+
+/**
+ A message which changes a value of an WDF object. The target is found on the control thread(e.g. by WDFTree::FindObject), so the audio thread doesn't search the objects.
+ */
+struct WDFParameter
+{
+	WDFParameter() : target(NULL), type(WDFParameterType::VOLTAGE), value(0.0) {}
+	WDFParameter(WDFObject* target, WDFParameterType type, double value) : target(target), type(type), value(value) {}
+	
+	/**
+	 the object to be changed
+	 */
+	WDFObject* target;
+	
+	/**
+	 the kind of the value
+	 */
+	WDFParameterType type;
+	
+	/**
+	 the new value. The models are given as the value of the enum.
+	 */
+	double value;
+};
+
+/**
+ A lock-free queue of the parameter messages from the control threads to the audio thread. Posting never blocks, and the audio thread drains the queue at the start of a block.
+ */
+class WDFParameterQueue
+{
+public:
+	/**
+	 Create a queue
+	 
+	 @param capacity the maximum number of messages waiting
+	 @param bMultiProducer true if the messages are posted from more than one thread
+	 */
+	WDFParameterQueue(unsigned int capacity, bool bMultiProducer);
+	~WDFParameterQueue();
+	
+	/**
+	 Post a message. If bMultiProducer is false, only one thread can post.
+	 
+	 @param param the message
+	 @return false if the queue is full
+	 */
+	bool Post(const WDFParameter &param);
+	
+	/**
+	 Take the oldest message(audio thread only)
+	 
+	 @param param the message taken
+	 @return false if the queue is empty
+	 */
+	bool Take(WDFParameter &param);
+	
+	/**
+	 Get the maximum number of messages waiting
+	 
+	 @return the capacity
+	 */
+	unsigned int GetCapacity();
+	
+	/**
+	 Check whether the messages can be posted from more than one thread
+	 
+	 @return true if the queue is for multiple producers
+	 */
+	bool IsMultiProducer();
+	
+	/**
+	 Apply a message to its target. The port resistances must be updated from the root afterwards if the function returns true.
+	 
+	 @param param the message
+	 @param T the sampling time at which the reactive elements are processed
+	 @return true if a port resistance has been changed
+	 */
+	static bool Apply(const WDFParameter &param, double T);
+	
+private:
+	WDFParameterQueue(const WDFParameterQueue&);
+	WDFParameterQueue& operator=(const WDFParameterQueue&);
+	
+	/**
+	 the maximum number of messages waiting
+	 */
+	unsigned int capacity;
+	
+	/**
+	 the queue for a single producer(NULL if not used)
+	 */
+	RingBuffer<WDFParameter>* spsc;
+	
+	/**
+	 the queue for multiple producers(NULL if not used)
+	 */
+	MPSCRingBuffer<WDFParameter>* mpsc;
+};
+
+#endif /* WDFParameter_hpp */
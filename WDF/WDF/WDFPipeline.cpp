@@ -0,0 +1,212 @@
+//
+//  WDFPipeline.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 21..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include "WDFPipeline.hpp"
+
+WDFPipeline::WDFPipeline(unsigned int blockSize, unsigned int latency, unsigned int nWorkers)
+{
+	this->blockSize = blockSize;
+	this->latency = latency;
+	this->nMaxWorkers = nWorkers > 0 ? nWorkers : 1;
+	
+	input = NULL;
+	inputPushed = NULL;
+	capacity = 0;
+	nUnderruns = 0;
+	nLateBlocks = 0;
+	bRunning = false;
+}
+
+WDFPipeline::~WDFPipeline()
+{
+	Stop();
+}
+
+void WDFPipeline::AddStage(WDFTree* tree)
+{
+	stages.push_back(tree);
+}
+
+bool WDFPipeline::Start()
+{
+	Stop();
+	
+	if(stages.empty())
+		return false;
+	
+	// Run in series on the calling thread
+	if(latency == 0)
+		return true;
+	
+	// Divide the stages into groups evenly
+	const unsigned int nStages = (unsigned int)stages.size();
+	const unsigned int nGroups = nStages < nMaxWorkers ? nStages : nMaxWorkers;
+	
+	// Each queue holds the blocks in flight
+	capacity = (latency + 1) * blockSize;
+	input = new RingBuffer<float>(capacity);
+	inputPushed = new SpinWait();
+	
+	nUnderruns = 0;
+	nLateBlocks = 0;
+	scratch.assign(blockSize, 0.0f);
+	
+	unsigned int iStage = 0;
+	for(unsigned int i=0; i<nGroups; i++)
+	{
+		Group* group = new Group();
+		group->iFirst = iStage;
+		iStage += (nStages - iStage) / (nGroups - i);
+		group->iLast = iStage;
+		group->output = new RingBuffer<float>(capacity);
+		group->outputPushed = new SpinWait();
+		group->outputPopped = new SpinWait();
+		groups.push_back(group);
+	}
+	
+	// The output is delayed by the latency
+	vector<float> silence(blockSize, 0.0f);
+	for(unsigned int i=0; i<latency; i++)
+		groups.back()->output->Push(&silence[0], blockSize);
+	
+	bRunning = true;
+	for(unsigned int i=0; i<nGroups; i++)
+		groups[i]->worker = std::thread(&WDFPipeline::Run, this, i);
+	
+	return true;
+}
+
+void WDFPipeline::Stop()
+{
+	bRunning = false;
+	
+	// Wake the sleeping workers
+	if(inputPushed)
+		inputPushed->Notify();
+	for(unsigned int i=0; i<groups.size(); i++)
+	{
+		groups[i]->outputPushed->Notify();
+		groups[i]->outputPopped->Notify();
+	}
+	
+	// A worker reads the queue of the previous group, so all workers finish first
+	for(unsigned int i=0; i<groups.size(); i++)
+		if(groups[i]->worker.joinable())
+			groups[i]->worker.join();
+	
+	for(unsigned int i=0; i<groups.size(); i++)
+	{
+		delete groups[i]->output;
+		delete groups[i]->outputPushed;
+		delete groups[i]->outputPopped;
+		delete groups[i];
+	}
+	groups.clear();
+	
+	delete input;
+	input = NULL;
+	delete inputPushed;
+	inputPushed = NULL;
+}
+
+void WDFPipeline::Process(const float* in, float* out)
+{
+	if(groups.empty())
+	{
+		// In series
+		if(in != out)
+			for(unsigned int i=0; i<blockSize; i++)
+				out[i] = in[i];
+		ProcessStages(out, 0, (unsigned int)stages.size());
+		return;
+	}
+	
+	RingBuffer<float>* output = groups.back()->output;
+	SpinWait* outputPopped = groups.back()->outputPopped;
+	
+	// Pass the block to the first group. If there is no space, the block is skipped as a whole, so the number of blocks in flight is kept.
+	if(capacity - input->GetCount() < blockSize)
+	{
+		for(unsigned int i=0; i<blockSize; i++)
+			out[i] = 0.0f;
+		nUnderruns++;
+		return;
+	}
+	input->Push(in, blockSize);
+	inputPushed->Notify();
+	
+	// Drop the blocks which arrived late, then the latency is restored
+	while(nLateBlocks > 0 && output->Pop(&scratch[0], blockSize))
+	{
+		nLateBlocks--;
+		outputPopped->Notify();
+	}
+	
+	// Get the block delayed by the latency from the last group, it's silence if the block isn't there yet
+	if(!output->Pop(out, blockSize))
+	{
+		for(unsigned int i=0; i<blockSize; i++)
+			out[i] = 0.0f;
+		nUnderruns++;
+		nLateBlocks++;
+		return;
+	}
+	outputPopped->Notify();
+}
+
+unsigned int WDFPipeline::GetLatency()
+{
+	return latency;
+}
+
+unsigned int WDFPipeline::GetWorkerCount()
+{
+	return (unsigned int)groups.size();
+}
+
+unsigned int WDFPipeline::GetUnderrunCount()
+{
+	return nUnderruns;
+}
+
+void WDFPipeline::ProcessStages(float* block, unsigned int iFirst, unsigned int iLast)
+{
+	for(unsigned int i=iFirst; i<iLast; i++)
+		stages[i]->Process(block, block, blockSize);
+}
+
+void WDFPipeline::Run(unsigned int iGroup)
+{
+	Group* group = groups[iGroup];
+	RingBuffer<float>* source = iGroup == 0 ? input : groups[iGroup-1]->output;
+	SpinWait* sourcePushed = iGroup == 0 ? inputPushed : groups[iGroup-1]->outputPushed;
+	SpinWait* sourcePopped = iGroup == 0 ? NULL : groups[iGroup-1]->outputPopped;	// the caller doesn't wait for the space
+	vector<float> block(blockSize);
+	
+	while(true)
+	{
+		// Sleep until a block comes(or the pipeline stops)
+		sourcePushed->Wait([this, source]{ return !bRunning || source->GetCount() >= blockSize; });
+		if(!bRunning)
+			return;
+		
+		source->Pop(&block[0], blockSize);
+		if(sourcePopped)
+			sourcePopped->Notify();
+		
+		ProcessStages(&block[0], group->iFirst, group->iLast);
+		
+		// Sleep until the next group takes a block if the queue is full
+		group->outputPopped->Wait([this, group]{ return !bRunning || capacity - group->output->GetCount() >= blockSize; });
+		if(!bRunning)
+			return;
+		
+		group->output->Push(&block[0], blockSize);
+		group->outputPushed->Notify();
+	}
+}
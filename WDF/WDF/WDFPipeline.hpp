@@ -0,0 +1,146 @@
+//
+//  WDFPipeline.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 21..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WDFPipeline_hpp
+#define WDFPipeline_hpp
+
+#include <atomic>
+#include <thread>
+#include "WDFTree.hpp"
+#include "RingBuffer.hpp"
+#include "SpinWait.hpp"
+
+/**
+ A class that runs a chain of WDF trees in series(e.g. preamp -> tone stack -> power amp -> cabinet). The stages are divided into groups of consecutive stages, and each group runs on its own worker thread. The blocks are passed between the groups through lock-free ring buffers, so the groups process different blocks at the same time.
+ 
+ The output is delayed by the latency in blocks. With the latency of the number of groups or more, each group has a whole block period to finish. If the latency is zero, the stages are processed in series on the calling thread.
+ 
+ The idle workers sleep after a short spin. The caller never waits or locks: it only polls the queues, and wakes the sleeping workers by a semaphore. If the block delayed by the latency isn't there yet, the output is silence and counted as an underrun, and the late block is dropped when it arrives to keep the latency.
+ */
+class WDFPipeline
+{
+public:
+	/**
+	 Create a pipeline
+	 
+	 @param blockSize the number of samples in a block
+	 @param latency the delay of the output in blocks
+	 @param nWorkers the maximum number of worker threads
+	 */
+	WDFPipeline(unsigned int blockSize, unsigned int latency, unsigned int nWorkers);
+	~WDFPipeline();
+	
+	/**
+	 Add a stage at the end of the chain. The tree is not owned by the pipeline. Call this before Start.
+	 
+	 @param tree a tree to be added
+	 */
+	void AddStage(WDFTree* tree);
+	
+	/**
+	 Divide the stages into groups, then start the worker threads
+	 
+	 @return false if there is no stage
+	 */
+	bool Start();
+	
+	/**
+	 Stop the worker threads. The blocks in flight are discarded.
+	 */
+	void Stop();
+	
+	/**
+	 Process a block. Call this from one thread only(e.g. audio thread). It never waits for the workers.
+	 
+	 @param in input samples(the size is the block size)
+	 @param out output samples(the size is the block size). It can be same as the input.
+	 */
+	void Process(const float* in, float* out);
+	
+	/**
+	 Get the latency
+	 
+	 @return the latency in blocks
+	 */
+	unsigned int GetLatency();
+	
+	/**
+	 Get the number of worker threads in use
+	 
+	 @return the number of worker threads
+	 */
+	unsigned int GetWorkerCount();
+	
+	/**
+	 Get the number of blocks output as silence because the workers were late
+	 
+	 @return the number of underruns since Start
+	 */
+	unsigned int GetUnderrunCount();
+	
+protected:
+	/**
+	 A group of consecutive stages run by a worker thread
+	 */
+	struct Group
+	{
+		unsigned int iFirst, iLast;		// the range of stages [iFirst, iLast)
+		RingBuffer<float>* output;		// the queue to the next group(or to the caller)
+		SpinWait* outputPushed;			// notified when a block is pushed to the output(the next group waits on it)
+		SpinWait* outputPopped;			// notified when a block is popped from the output(this group waits on it)
+		std::thread worker;
+	};
+	
+	/**
+	 Process the stages in [iFirst, iLast) in series
+	 
+	 @param block samples processed in place
+	 @param iFirst the first stage
+	 @param iLast the stage after the last
+	 */
+	void ProcessStages(float* block, unsigned int iFirst, unsigned int iLast);
+	
+	/**
+	 The loop of a worker thread
+	 
+	 @param iGroup the index of group
+	 */
+	void Run(unsigned int iGroup);
+	
+	/**
+	 the stages in order
+	 */
+	vector<WDFTree*> stages;
+	
+	/**
+	 the groups of stages
+	 */
+	vector<Group*> groups;
+	
+	/**
+	 the queue from the caller to the first group
+	 */
+	RingBuffer<float>* input;
+	SpinWait* inputPushed;		// the first group waits on it for a block
+	
+	unsigned int blockSize;
+	unsigned int latency;
+	unsigned int nMaxWorkers;
+	unsigned int capacity;		// the size of the queues
+	
+	unsigned int nUnderruns;	// the blocks output as silence
+	unsigned int nLateBlocks;	// the late blocks to be dropped
+	vector<float> scratch;		// a late block is popped to here
+	
+	/**
+	 true while the worker threads run
+	 */
+	std::atomic<bool> bRunning;
+};
+
+#endif /* WDFPipeline_hpp */
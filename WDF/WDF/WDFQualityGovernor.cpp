@@ -0,0 +1,190 @@
+//
+//  WDFQualityGovernor.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 25..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include "WDFQualityGovernor.hpp"
+
+WDFQualityGovernor::WDFQualityGovernor(WDFTree* tree)
+{
+	this->tree = tree;
+	reduced = NULL;
+	active = tree;
+	fading = NULL;
+	nFadeLeft = 0;
+	lowest = WDFQuality::REDUCED_RATE;
+	load = 0.0;
+	nLightBlocks = 0;
+	nDegrades = 0;
+	SetThresholds();
+	SetCrossfade(64);
+	Prepare();
+}
+
+WDFQualityGovernor::~WDFQualityGovernor()
+{
+	delete reduced;
+}
+
+void WDFQualityGovernor::SetThresholds(double degradeRatio, double restoreRatio, unsigned int holdBlocks)
+{
+	this->degradeRatio = degradeRatio;
+	this->restoreRatio = restoreRatio;
+	nHoldBlocks = holdBlocks;
+	nLightBlocks = 0;
+}
+
+void WDFQualityGovernor::SetLowestQuality(WDFQuality quality)
+{
+	lowest = quality;
+	if(GetQuality() > lowest)
+	{
+		// Back to the full rate at once
+		if(active == reduced)
+		{
+			tree->TransferStates(reduced);
+			active = tree;
+			fading = NULL;
+			nFadeLeft = 0;
+		}
+		if(tree->GetQuality() > lowest)
+			tree->SetQuality(lowest);
+	}
+	
+	if(lowest == WDFQuality::REDUCED_RATE && !reduced)
+		Prepare();
+}
+
+void WDFQualityGovernor::Prepare()
+{
+	if(active == reduced && reduced)
+		tree->TransferStates(reduced);
+	active = tree;
+	fading = NULL;
+	nFadeLeft = 0;
+	
+	delete reduced;
+	reduced = NULL;
+	
+	// The matrices of the reduced rate are computed here, not on the audio thread
+	if(lowest == WDFQuality::REDUCED_RATE && tree->GetOversampling() > 1 && tree->GetQuality() != WDFQuality::REDUCED_RATE)
+	{
+		reduced = tree->CreateInstance();
+		if(reduced)
+			reduced->SetQuality(WDFQuality::REDUCED_RATE);
+	}
+}
+
+void WDFQualityGovernor::SetCrossfade(unsigned int nSamples)
+{
+	nCrossfade = nSamples;
+	fadeBuffer.resize(nSamples);
+	fading = NULL;
+	nFadeLeft = 0;
+}
+
+bool WDFQualityGovernor::PostParameter(string id, WDFParameterType type, double value)
+{
+	bool bPosted = tree->PostParameter(id, type, value);
+	if(reduced)
+		bPosted = reduced->PostParameter(id, type, value) && bPosted;
+	return bPosted;
+}
+
+void WDFQualityGovernor::Process(const float* in, float* out, unsigned int nSamples)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	// The tree before the switch runs until the end of the crossfade(before the input can be overwritten)
+	const unsigned int nFade = fading ? min(nFadeLeft, nSamples) : 0;
+	for(unsigned int i=0; i<nFade; i++)
+		fadeBuffer[i] = fading->Process(in[i]);
+	
+	active->Process(in, out, nSamples);
+	
+	for(unsigned int i=0; i<nFade; i++)
+	{
+		const float gain = (float)(nCrossfade - nFadeLeft + i + 1) / (float)(nCrossfade + 1);
+		out[i] = gain * out[i] + (1.0f - gain) * fadeBuffer[i];
+	}
+	if(nFade > 0)
+	{
+		nFadeLeft -= nFade;
+		if(nFadeLeft == 0)
+			fading = NULL;
+	}
+	
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	const double deadline = nSamples * tree->GetSamplingTime();
+	if(deadline <= 0.0)
+		return;
+	load = elapsed / deadline;
+	
+	const WDFQuality quality = GetQuality();
+	if(load > degradeRatio)
+	{
+		// Lower at once, then the next block gets the headroom
+		nLightBlocks = 0;
+		if(quality < lowest && SetQuality((WDFQuality)((int)quality + 1)))
+			nDegrades++;
+	}
+	else if(load < restoreRatio && quality != WDFQuality::FULL)
+	{
+		// Raise slowly
+		if(++nLightBlocks >= nHoldBlocks)
+		{
+			SetQuality((WDFQuality)((int)quality - 1));
+			nLightBlocks = 0;
+		}
+	}
+	else
+	{
+		nLightBlocks = 0;
+	}
+}
+
+double WDFQualityGovernor::GetLoad()
+{
+	return load;
+}
+
+unsigned int WDFQualityGovernor::GetDegradeCount()
+{
+	return nDegrades;
+}
+
+WDFQuality WDFQualityGovernor::GetQuality()
+{
+	return active == reduced && reduced ? WDFQuality::REDUCED_RATE : tree->GetQuality();
+}
+
+bool WDFQualityGovernor::SetQuality(WDFQuality quality)
+{
+	const bool bToReduced = quality == WDFQuality::REDUCED_RATE;
+	const bool bFromReduced = GetQuality() == WDFQuality::REDUCED_RATE;
+	if(bToReduced == bFromReduced)
+	{
+		tree->SetQuality(quality);
+		return true;
+	}
+	
+	// The rate isn't changed on the audio thread: without the instance, the tree stays at the lower levels
+	if(!reduced || fading)
+		return false;
+	
+	WDFTree* next = bToReduced ? reduced : tree;
+	next->TransferStates(active);
+	if(nCrossfade > 0)
+	{
+		fading = active;
+		nFadeLeft = nCrossfade;
+	}
+	active = next;
+	return true;
+}
@@ -0,0 +1,179 @@
+//
+//  WDFQualityGovernor.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 25..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WDFQualityGovernor_hpp
+#define WDFQualityGovernor_hpp
+
+#include "WDFTree.hpp"
+
+/**
+ A class that processes a tree while watching the time of each block against its deadline(the duration of the block). If a block takes more than the degrade ratio of the deadline, the quality of the tree is lowered by one level at once. The quality is raised by one level after the load has stayed below the restore ratio for the hold blocks. The gap between the two ratios and the hold prevents the quality from toggling.
+ 
+ Changing the oversampling factor would update the matrices on the audio thread, so WDFQuality::REDUCED_RATE is processed by an instance of the tree prepared at the reduced rate on the control thread. The governor switches between the two trees by taking over the states and crossfading the outputs, so nothing is allocated or cleared on the audio thread. Post the parameters through the governor, then both trees receive them.
+ */
+class WDFQualityGovernor
+{
+public:
+	/**
+	 Create a governor. The instance of the reduced rate is prepared, so create it while the tree is not processed.
+	 
+	 @param tree the tree to be processed. It's not owned by the governor.
+	 */
+	WDFQualityGovernor(WDFTree* tree);
+	~WDFQualityGovernor();
+	
+	/**
+	 Set the thresholds of the load. The load is the processing time divided by the duration of the block.
+	 
+	 @param degradeRatio the load above which the quality is lowered
+	 @param restoreRatio the load below which the quality can be raised. It should be less than half of degradeRatio if the oversampling is reduced.
+	 @param holdBlocks the number of successive light blocks required before raising the quality
+	 */
+	void SetThresholds(double degradeRatio=0.7, double restoreRatio=0.3, unsigned int holdBlocks=32);
+	
+	/**
+	 Set the lowest quality allowed. Call it while the tree is not processed(the instance of the reduced rate may be created).
+	 
+	 @param quality the lowest quality level
+	 */
+	void SetLowestQuality(WDFQuality quality);
+	
+	/**
+	 Create the instance of the reduced rate again after the settings of the tree(e.g. the oversampling factor or the solvers) are changed. Call it while the tree is not processed.
+	 */
+	void Prepare();
+	
+	/**
+	 Set the length of the crossfade between the trees of the full and the reduced rate. Call it on the control thread.
+	 
+	 @param nSamples the number of samples(0: switch at once)
+	 */
+	void SetCrossfade(unsigned int nSamples);
+	
+	/**
+	 Post a parameter message to the object with id in both trees
+	 
+	 @param id the id of the target
+	 @param type the kind of the value
+	 @param value the new value
+	 @return false if the object isn't found or a queue is full
+	 */
+	bool PostParameter(string id, WDFParameterType type, double value);
+	
+	/**
+	 Process a block, then update the quality for the next block
+	 
+	 @param in input voltages
+	 @param out output voltages. It can be same as the input.
+	 @param nSamples the number of samples in the block
+	 */
+	void Process(const float* in, float* out, unsigned int nSamples);
+	
+	/**
+	 Get the load of the last block
+	 
+	 @return the processing time divided by the duration of the block
+	 */
+	double GetLoad();
+	
+	/**
+	 Get the number of times the quality has been lowered
+	 
+	 @return the count
+	 */
+	unsigned int GetDegradeCount();
+	
+	/**
+	 Get the quality in use
+	 
+	 @return the quality of the tree, or WDFQuality::REDUCED_RATE while the instance of the reduced rate is processed
+	 */
+	WDFQuality GetQuality();
+	
+protected:
+	/**
+	 Change the quality by one level. The rate is changed by switching the trees.
+	 
+	 @param quality the new quality level
+	 @return false if the quality isn't changed
+	 */
+	bool SetQuality(WDFQuality quality);
+	
+
+	/**
+	 the tree to be processed
+	 */
+	WDFTree* tree;
+	
+	/**
+	 the instance of the tree at WDFQuality::REDUCED_RATE(owned, NULL if the rate isn't reduced)
+	 */
+	WDFTree* reduced;
+	
+	/**
+	 the tree processed now(tree or reduced)
+	 */
+	WDFTree* active;
+	
+	/**
+	 the tree processed before the switch until the crossfade ends
+	 */
+	WDFTree* fading;
+	
+	/**
+	 the output of the fading tree(nCrossfade samples)
+	 */
+	vector<float> fadeBuffer;
+	
+	/**
+	 the length of the crossfade
+	 */
+	unsigned int nCrossfade;
+	
+	/**
+	 the number of samples of the crossfade left
+	 */
+	unsigned int nFadeLeft;
+	
+	/**
+	 the load above which the quality is lowered
+	 */
+	double degradeRatio;
+	
+	/**
+	 the load below which the quality can be raised
+	 */
+	double restoreRatio;
+	
+	/**
+	 the number of successive light blocks required before raising the quality
+	 */
+	unsigned int nHoldBlocks;
+	
+	/**
+	 the number of successive light blocks
+	 */
+	unsigned int nLightBlocks;
+	
+	/**
+	 the lowest quality allowed
+	 */
+	WDFQuality lowest;
+	
+	/**
+	 the load of the last block
+	 */
+	double load;
+	
+	/**
+	 the number of times the quality has been lowered
+	 */
+	unsigned int nDegrades;
+};
+
+#endif /* WDFQualityGovernor_hpp */
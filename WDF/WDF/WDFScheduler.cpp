@@ -0,0 +1,306 @@
+//
+//  WDFScheduler.cpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 22..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#include <algorithm>
+#include <chrono>
+#include "WDFScheduler.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+WDFScheduler::WDFScheduler(unsigned int nWorkers, bool bPinWorkers)
+{
+	this->nWorkers = nWorkers > 0 ? nWorkers : 1;
+	this->bPinWorkers = bPinWorkers;
+	epoch = 0;
+	timeout = 0.0;
+	nUnderruns = 0;
+	nStolen = 0;
+	bRunning = true;
+	
+	queues.resize(this->nWorkers);
+	loads.resize(this->nWorkers);
+	workerEpochs = new std::atomic<unsigned int>[this->nWorkers];
+	wake = new SpinWait[this->nWorkers];
+	for(unsigned int i=0; i<this->nWorkers; i++)
+		workerEpochs[i] = 0;
+	
+	// The calling thread is the worker #0
+	for(unsigned int i=1; i<this->nWorkers; i++)
+		threads.push_back(std::thread(&WDFScheduler::Run, this, i));
+}
+
+WDFScheduler::~WDFScheduler()
+{
+	bRunning = false;
+	for(unsigned int i=1; i<nWorkers; i++)
+		wake[i].Notify();
+	for(unsigned int i=0; i<threads.size(); i++)
+		threads[i].join();
+	
+	for(unsigned int i=0; i<jobs.size(); i++)
+		delete jobs[i];
+	delete[] workerEpochs;
+	delete[] wake;
+}
+
+unsigned int WDFScheduler::AddTree(WDFTree* tree, double cost, int affinity)
+{
+	// A late worker may still read the jobs
+	done.Wait([this]{ return IsIdle(); });
+	
+	Job* job = new Job();
+	job->tree = tree;
+	job->length = 0;
+	job->cost = cost;
+	job->measured = 0.0;
+	job->affinity = affinity;
+	job->loaded = 0;
+	job->claimed = epoch.load();
+	job->finished = job->claimed.load();
+	jobs.push_back(job);
+	
+	// Schedule runs on the caller of Process, so its memory is reserved here
+	order.resize(jobs.size());
+	for(unsigned int w=0; w<nWorkers; w++)
+		queues[w].reserve(jobs.size());
+	
+	return (unsigned int)jobs.size() - 1;
+}
+
+void WDFScheduler::SetCost(unsigned int iTree, double cost)
+{
+	jobs[iTree]->cost = cost;
+}
+
+void WDFScheduler::SetAffinity(unsigned int iTree, int affinity)
+{
+	jobs[iTree]->affinity = affinity;
+}
+
+void WDFScheduler::SetTimeout(double seconds)
+{
+	timeout = seconds;
+}
+
+void WDFScheduler::Process(const float* const* in, float* const* out, unsigned int nSamples)
+{
+	if(jobs.empty())
+		return;
+	
+	const double seconds = timeout > 0.0 ? timeout : nSamples * (double)jobs[0]->tree->GetSamplingTime();
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+	
+	// The queues are read by the late workers, so they're kept until all workers leave
+	if(IsIdle())
+		Schedule();
+	
+	const unsigned int current = epoch.load(std::memory_order_relaxed) + 1;
+	for(unsigned int i=0; i<jobs.size(); i++)
+		Load(jobs[i], in[i], nSamples, current);
+	
+	// Wake the workers
+	nStolen.store(0, std::memory_order_relaxed);
+	epoch.store(current, std::memory_order_release);
+	for(unsigned int i=1; i<nWorkers; i++)
+		wake[i].Notify();
+	
+	// Work as the worker #0, then poll the others until the deadline(the caller never sleeps)
+	Work(0, current);
+	SpinWait::SpinUntil([this, current]
+	{
+		for(unsigned int i=0; i<jobs.size(); i++)
+			if(jobs[i]->loaded.load(std::memory_order_relaxed) == current && jobs[i]->finished.load(std::memory_order_acquire) != current)
+				return false;
+		return true;
+	}, deadline);
+	
+	// The unfinished trees output silence, and they're skipped until their workers finish
+	for(unsigned int i=0; i<jobs.size(); i++)
+	{
+		Job* job = jobs[i];
+		if(job->loaded.load(std::memory_order_relaxed) == current && job->finished.load(std::memory_order_acquire) == current)
+		{
+			copy(job->buffer.begin(), job->buffer.begin() + nSamples, out[i]);
+		}
+		else
+		{
+			fill(out[i], out[i] + nSamples, 0.0f);
+			nUnderruns++;
+		}
+	}
+}
+
+unsigned int WDFScheduler::GetStolenCount()
+{
+	return nStolen.load();
+}
+
+unsigned int WDFScheduler::GetUnderrunCount()
+{
+	return nUnderruns;
+}
+
+unsigned int WDFScheduler::GetWorkerCount()
+{
+	return nWorkers;
+}
+
+void WDFScheduler::Schedule()
+{
+	// Sort by the cost(the measured time is used if the cost is not given)
+	for(unsigned int i=0; i<jobs.size(); i++)
+		order[i] = make_pair(jobs[i]->cost > 0.0 ? jobs[i]->cost : jobs[i]->measured, i);
+	sort(order.begin(), order.end(), greater< pair<double, unsigned int> >());
+	
+	// Give each tree to the least loaded worker, or to the preferred one
+	for(unsigned int w=0; w<nWorkers; w++)
+	{
+		queues[w].clear();
+		loads[w] = 0.0;
+	}
+	
+	for(unsigned int i=0; i<order.size(); i++)
+	{
+		Job* job = jobs[order[i].second];
+		unsigned int w = 0;
+		if(job->affinity >= 0)
+		{
+			w = (unsigned int)job->affinity % nWorkers;
+		}
+		else
+		{
+			for(unsigned int k=1; k<nWorkers; k++)
+				if(loads[k] < loads[w])
+					w = k;
+		}
+		
+		queues[w].push_back(order[i].second);
+		loads[w] += order[i].first;
+	}
+}
+
+bool WDFScheduler::IsIdle()
+{
+	const unsigned int current = epoch.load(std::memory_order_relaxed);
+	for(unsigned int w=1; w<nWorkers; w++)
+		if(workerEpochs[w].load(std::memory_order_acquire) != current)
+			return false;
+	return true;
+}
+
+bool WDFScheduler::Load(Job* job, const float* in, unsigned int nSamples, unsigned int current)
+{
+	// Still running from an earlier block
+	unsigned int claimed = job->claimed.load(std::memory_order_acquire);
+	if(job->finished.load(std::memory_order_acquire) != claimed)
+		return false;
+	
+	// Take the tree back from the late workers of the last block, then the buffer is ours
+	if(claimed != current - 1)
+	{
+		if(!job->claimed.compare_exchange_strong(claimed, current - 1, std::memory_order_acq_rel))
+			return false;
+		job->finished.store(current - 1, std::memory_order_release);
+	}
+	
+	if(job->buffer.size() < nSamples)
+		job->buffer.resize(nSamples);
+	copy(in, in + nSamples, job->buffer.begin());
+	job->length = nSamples;
+	job->loaded.store(current, std::memory_order_release);
+	return true;
+}
+
+void WDFScheduler::Work(unsigned int iWorker, unsigned int current)
+{
+	// Own trees from the most expensive one
+	const vector<unsigned int>& own = queues[iWorker];
+	for(unsigned int i=0; i<own.size(); i++)
+	{
+		Job* job = jobs[own[i]];
+		if(Claim(job, current))
+			RunJob(job, current);
+	}
+	
+	// Steal from the cheapest trees of the others
+	for(unsigned int k=1; k<nWorkers; k++)
+	{
+		const vector<unsigned int>& victim = queues[(iWorker + k) % nWorkers];
+		for(unsigned int i=(unsigned int)victim.size(); i>0; i--)
+		{
+			Job* job = jobs[victim[i-1]];
+			if(Claim(job, current))
+			{
+				RunJob(job, current);
+				nStolen.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+bool WDFScheduler::Claim(Job* job, unsigned int current)
+{
+	if(job->loaded.load(std::memory_order_acquire) != current)
+		return false;
+	
+	unsigned int claimed = job->claimed.load(std::memory_order_acquire);
+	if(claimed == current || job->finished.load(std::memory_order_acquire) != claimed)
+		return false;
+	
+	return job->claimed.compare_exchange_strong(claimed, current, std::memory_order_acq_rel);
+}
+
+void WDFScheduler::RunJob(Job* job, unsigned int current)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	job->tree->Process(&job->buffer[0], &job->buffer[0], job->length);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	// Moving average of the time
+	job->measured = job->measured > 0.0 ? 0.9 * job->measured + 0.1 * elapsed : elapsed;
+	job->finished.store(current, std::memory_order_release);
+}
+
+void WDFScheduler::Run(unsigned int iWorker)
+{
+	if(bPinWorkers)
+		PinThread(iWorker);
+	
+	unsigned int lastEpoch = 0;
+	while(true)
+	{
+		wake[iWorker].Wait([this, &lastEpoch]{ return epoch.load(std::memory_order_acquire) != lastEpoch || !bRunning.load(); });
+		if(!bRunning.load())
+			break;
+		
+		lastEpoch = epoch.load(std::memory_order_acquire);
+		Work(iWorker, lastEpoch);
+		workerEpochs[iWorker].store(lastEpoch, std::memory_order_release);
+		done.Notify();
+	}
+}
+
+void WDFScheduler::PinThread(unsigned int iCore)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(iCore % std::thread::hardware_concurrency(), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+	// macOS has no hard binding, the threads with different tags are spread over the cores
+	thread_affinity_policy_data_t policy = { (integer_t)(iCore + 1) };
+	thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#endif
+}
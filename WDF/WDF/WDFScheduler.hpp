@@ -0,0 +1,226 @@
+//
+//  WDFScheduler.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 22..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WDFScheduler_hpp
+#define WDFScheduler_hpp
+
+#include <atomic>
+#include <thread>
+#include "WDFTree.hpp"
+#include "SpinWait.hpp"
+
+/**
+ A class that processes a block of many independent WDF trees(e.g. one per channel) on a fixed pool of workers. The calling thread works as the worker #0.
+ 
+ Before each block, the trees are sorted by their cost and given to the least loaded worker(or to the worker of the affinity hint). Each worker processes its own trees from the most expensive one, then steals the remaining trees of the other workers from the cheapest one. A tree is claimed by an atomic tag of the block, so it's processed exactly once without locks.
+ 
+ The idle workers sleep after a short spin, and the caller wakes them by a semaphore without locking. The caller never sleeps: it polls the other workers no longer than the timeout, then a tree which isn't finished outputs silence(an underrun), and it's skipped until its worker finishes. Each tree is processed in its own buffer, so a late worker never touches the blocks of the caller.
+ */
+class WDFScheduler
+{
+public:
+	/**
+	 Create a scheduler
+	 
+	 @param nWorkers the number of workers including the calling thread
+	 @param bPinWorkers true if the worker threads are bound to the cores(if supported by the platform)
+	 */
+	WDFScheduler(unsigned int nWorkers, bool bPinWorkers=false);
+	~WDFScheduler();
+	
+	/**
+	 Add a tree. The tree is not owned by the scheduler. It waits for the late workers of the last block, so call it from one thread other than the caller of Process(or between the blocks).
+	 
+	 @param tree a tree to be added
+	 @param cost the estimated cost of a block(any unit). 0 means that it's measured.
+	 @param affinity the worker which processes the tree first, or -1 if none
+	 @return the index of the tree
+	 */
+	unsigned int AddTree(WDFTree* tree, double cost=0.0, int affinity=-1);
+	
+	/**
+	 Change the cost estimate of a tree
+	 
+	 @param iTree the index of the tree
+	 @param cost the estimated cost of a block. 0 means that it's measured.
+	 */
+	void SetCost(unsigned int iTree, double cost);
+	
+	/**
+	 Change the affinity hint of a tree
+	 
+	 @param iTree the index of the tree
+	 @param affinity the worker which processes the tree first, or -1 if none
+	 */
+	void SetAffinity(unsigned int iTree, int affinity);
+	
+	/**
+	 Set the longest time for which Process polls the other workers
+	 
+	 @param seconds the timeout. 0 means the period of a block at the sampling rate of the first tree.
+	 */
+	void SetTimeout(double seconds);
+	
+	/**
+	 Process a block of all trees, then return when all trees are processed or the timeout has passed. The buffers of the trees are allocated only when the block becomes longer.
+	 
+	 @param in input blocks in order of the trees
+	 @param out output blocks in order of the trees. Each block can be same as the input.
+	 @param nSamples the number of samples in a block
+	 */
+	void Process(const float* const* in, float* const* out, unsigned int nSamples);
+	
+	/**
+	 Get the number of trees processed by stealing in the last block
+	 
+	 @return the number of stolen trees
+	 */
+	unsigned int GetStolenCount();
+	
+	/**
+	 Get the number of tree blocks output as silence because they weren't finished in time
+	 
+	 @return the number of underruns since the scheduler is created
+	 */
+	unsigned int GetUnderrunCount();
+	
+	/**
+	 Get the number of workers
+	 
+	 @return the number of workers including the calling thread
+	 */
+	unsigned int GetWorkerCount();
+	
+protected:
+	/**
+	 A tree with its schedule
+	 */
+	struct Job
+	{
+		WDFTree* tree;
+		vector<float> buffer;					// the block processed in place
+		unsigned int length;					// the number of samples in the buffer
+		double cost;							// the cost estimate given by the user(0: measured)
+		double measured;						// the average time of a block(seconds)
+		int affinity;							// the preferred worker
+		std::atomic<unsigned int> loaded;		// the block(epoch) of the input in the buffer
+		std::atomic<unsigned int> claimed;		// the last block in which a worker took the tree
+		std::atomic<unsigned int> finished;		// the last block in which the tree was finished
+	};
+	
+	/**
+	 Assign the trees to the workers by the cost(longest processing time first). It doesn't allocate.
+	 */
+	void Schedule();
+	
+	/**
+	 Check whether all worker threads have left the last block
+	 
+	 @return true if no worker thread reads the queues
+	 */
+	bool IsIdle();
+	
+	/**
+	 Copy the input of a tree into its buffer unless the tree is still running
+	 
+	 @param job the tree
+	 @param in the input block
+	 @param nSamples the number of samples
+	 @param current the epoch of the new block
+	 @return true if the tree is processed in this block
+	 */
+	bool Load(Job* job, const float* in, unsigned int nSamples, unsigned int current);
+	
+	/**
+	 Process the trees of a worker, then steal from the others
+	 
+	 @param iWorker the index of worker
+	 @param current the epoch of the block
+	 */
+	void Work(unsigned int iWorker, unsigned int current);
+	
+	/**
+	 Take a tree for the block if it's not taken and not running
+	 
+	 @param job the tree
+	 @param current the epoch of the block
+	 @return true if taken
+	 */
+	bool Claim(Job* job, unsigned int current);
+	
+	/**
+	 Process a tree
+	 
+	 @param job the tree to be processed
+	 @param current the epoch of the block
+	 */
+	void RunJob(Job* job, unsigned int current);
+	
+	/**
+	 The loop of a worker thread
+	 
+	 @param iWorker the index of worker
+	 */
+	void Run(unsigned int iWorker);
+	
+	/**
+	 Bind the calling thread to a core
+	 
+	 @param iCore the index of core
+	 */
+	void PinThread(unsigned int iCore);
+	
+	vector<Job*> jobs;
+	
+	/**
+	 the indices of the trees assigned to each worker, from the most expensive one(reserved for all trees)
+	 */
+	vector< vector<unsigned int> > queues;
+	
+	vector< pair<double, unsigned int> > order;	// the trees sorted by the cost(sized by AddTree)
+	vector<double> loads;						// the cost assigned to each worker
+	
+	vector<std::thread> threads;
+	unsigned int nWorkers;
+	bool bPinWorkers;
+	
+	/**
+	 increased by each block to wake the workers
+	 */
+	std::atomic<unsigned int> epoch;
+	
+	/**
+	 the last epoch finished by each worker thread(nWorkers values, #0 is not used)
+	 */
+	std::atomic<unsigned int>* workerEpochs;
+	
+	/**
+	 the worker threads sleep on them between the blocks(nWorkers waits, #0 is not used)
+	 */
+	SpinWait* wake;
+	
+	/**
+	 AddTree sleeps on it until the late workers leave
+	 */
+	SpinWait done;
+	
+	double timeout;				// the longest poll of Process(seconds, 0: a block period)
+	unsigned int nUnderruns;	// the tree blocks output as silence
+	
+	/**
+	 the number of stolen trees in this block
+	 */
+	std::atomic<unsigned int> nStolen;
+	
+	/**
+	 true while the worker threads run
+	 */
+	std::atomic<bool> bRunning;
+};
+
+#endif /* WDFScheduler_hpp */
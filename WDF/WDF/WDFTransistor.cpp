@@ -18,41 +18,74 @@ WDFRTypeTransistor::~WDFRTypeTransistor()
 	
 }
 
+WDFObject* WDFRTypeTransistor::Clone()
+{
+	return new WDFRTypeTransistor(*this);
+}
+
 vec WDFRTypeTransistor::Nonlinear(vec V)
+{
+	vec I(2);
+	Nonlinear(V.memptr(), I.memptr());
+	return I;
+}
+
+mat WDFRTypeTransistor::DiffNonlinear(vec V)
+{
+	mat J(2,2);
+	DiffNonlinear(V.memptr(), J.memptr(), 2);
+	return J;
+}
+
+void WDFRTypeTransistor::Nonlinear(const double* V, double* I)
 {
 	//============================================================
 	// input value: V = [Vbc, Vbe]'
 	// return value: I = [Ibc, Ibe]'
 	//============================================================
-	vec I(2);
-	
-	const double Vbc = V(0);
-	const double Vbe = V(1);
+	const double Vbc = V[0];
+	const double Vbe = V[1];
 	
 	double Ic = Is * (exp(Vbe / Vt) - 1.0) - Is / alphaR * (exp(Vbc / Vt) - 1.0);
 	double Ie = Is / alphaF * (exp(Vbe / Vt) - 1.0) - Is * (exp(Vbc / Vt) - 1.0);
 	
-	I(0) = -Ic;
-	I(1) = Ie;
-	
-	return I;
+	I[0] = -Ic;
+	I[1] = Ie;
 }
 
-mat WDFRTypeTransistor::DiffNonlinear(vec V)
+void WDFRTypeTransistor::DiffNonlinear(const double* V, double* J, unsigned int ld)
+{
+	double I[2];
+	NonlinearWithJacobian(V, I, J, ld);
+}
+
+void WDFRTypeTransistor::NonlinearWithJacobian(const double* V, double* I, double* J, unsigned int ld)
 {
-	const double Vbc = V(0);
-	const double Vbe = V(1);
+	// the exps of the junctions are shared by Ic, Ie & the Jacobian
+	const double expBC = exp(V[0] / Vt);
+	const double expBE = exp(V[1] / Vt);
 	
-	double dIc_by_dVbc = -Is / (alphaR * Vt) * exp(Vbc / Vt);
-	double dIc_by_dVbe = Is / Vt * exp(Vbe / Vt);
-	double dIe_by_dVbc = -Is / Vt * exp(Vbc / Vt);
-	double dIe_by_dVbe = Is / (alphaF * Vt) * exp(Vbe / Vt);
+	double Ic = Is * (expBE - 1.0) - Is / alphaR * (expBC - 1.0);
+	double Ie = Is / alphaF * (expBE - 1.0) - Is * (expBC - 1.0);
 	
-	mat I(2,2);
-	I(0,0) = -dIc_by_dVbc;
-	I(0,1) = -dIc_by_dVbe;
-	I(1,0) = dIe_by_dVbc;
-	I(1,1) = dIe_by_dVbe;
+	I[0] = -Ic;
+	I[1] = Ie;
 	
-	return I;
+	double dIc_by_dVbc = -Is / (alphaR * Vt) * expBC;
+	double dIc_by_dVbe = Is / Vt * expBE;
+	double dIe_by_dVbc = -Is / Vt * expBC;
+	double dIe_by_dVbe = Is / (alphaF * Vt) * expBE;
+	
+	// J(r,c) = J[c * ld + r]
+	J[0] = -dIc_by_dVbc;
+	J[ld] = -dIc_by_dVbe;
+	J[1] = dIe_by_dVbc;
+	J[ld + 1] = dIe_by_dVbe;
+}
+
+void WDFRTypeTransistor::LimitVoltage(const double* Vold, double* Vnew)
+{
+	const double vCrit = Vt * log(Vt / (sqrt(2.0) * Is));
+	Vnew[0] = LimitJunctionVoltage(Vnew[0], Vold[0], Vt, vCrit);
+	Vnew[1] = LimitJunctionVoltage(Vnew[1], Vold[1], Vt, vCrit);
 }
@@ -21,6 +21,7 @@ class WDFRTypeTransistor : public WDFRTypeRootLeaf, public TransistorParam
 public:
 	WDFRTypeTransistor(TransistorModel model, string label="Transistor");
 	~WDFRTypeTransistor();
+	virtual WDFObject* Clone();
 	
 	//============================================================
 	// Nonlinear function
@@ -34,6 +35,14 @@ public:
 	// Output: [d(Ibc)/d(Vbc), d(Ibc)/d(Vbe)]
 	//		   [d(Ibe)/d(Vbc), d(Ibe)/d(Vbe)]
 	virtual mat DiffNonlinear(vec V);
+	
+	// allocation-free versions(called by the root)
+	virtual void Nonlinear(const double* V, double* I);
+	virtual void DiffNonlinear(const double* V, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* V, double* I, double* J, unsigned int ld);
+	
+	// pn-junction limiting of Vbc & Vbe
+	virtual void LimitVoltage(const double* Vold, double* Vnew);
 };
 
 #endif /* WDFTransistor_hpp */
@@ -6,19 +6,42 @@
 //  Copyright © 2018년 Anti Mouse. All rights reserved.
 //
 
+#include <cmath>
 #include "WDFTree.hpp"
+#include "Denormal.hpp"
 
 WDFTree::WDFTree(float T, float V, float F)
 {
 	this->T = T;
 	this->V = V;
 	this->F = F;
+	
+	wdfRoot = NULL;
+	wdfInput = NULL;
+	
+	bSleepEnabled = false;
+	bSleeping = false;
+	fSleepThreshold = 1e-6f;
+	nSleepHoldSamples = 64;
+	nSilentSamples = 0;
+	fPrevOutput = 0.0;
+	
+	bDenormalMode = false;
+	
+	engine = WDFEngine::WAVE;
+	
+	nOversampling = 1;
+	quality = WDFQuality::FULL;
+	
+	parameterQueue = new WDFParameterQueue(256, true);
 }
 
 WDFTree::~WDFTree()
 {
 	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
 		delete (*mapIter).second;
+	
+	delete parameterQueue;
 }
 
 float WDFTree::Process(float Vin)
@@ -27,9 +50,50 @@ float WDFTree::Process(float Vin)
 	if(!wdfInput || !wdfRoot)
 		return 0.0;
 	
+	// Skip the propagation while sleeping
+	if(bSleeping)
+	{
+		if(fabs(Vin) <= fSleepThreshold)
+			return fPrevOutput;
+		
+		// Wake up by non-silent input
+		bSleeping = false;
+		nSilentSamples = 0;
+	}
+	
+	float Vout;
+	unsigned int factor = oversampler.GetFactor();
+	if(factor > 1)
+	{
+		// Process at the internal rate
+		float samples[MAX_OVERSAMPLING];
+		oversampler.Upsample(Vin, samples);
+		for(unsigned int i=0; i<factor; i++)
+			samples[i] = ProcessSample(samples[i]);
+		Vout = oversampler.Downsample(samples);
+	}
+	else
+	{
+		Vout = ProcessSample(Vin);
+	}
+	
+	// Check whether the tree can sleep
+	if(bSleepEnabled)
+		UpdateSleepState(Vin, Vout);
+	
+	fPrevOutput = Vout;
+	
+	return Vout;
+}
+
+float WDFTree::ProcessSample(float Vin)
+{
 	// Set input voltage
 	wdfInput->Vs = Vin;
 	
+	if(engine == WDFEngine::STATE_SPACE)
+		return stateSpace.Process(Vin);
+	
 	// Wave up & down
 	wdfRoot->WaveUp();
 	wdfRoot->WaveDown();
@@ -42,14 +106,239 @@ float WDFTree::Process(float Vin)
 	return Vout;
 }
 
+void WDFTree::Process(const float* in, float* out, unsigned int nSamples)
+{
+	ApplyParameters();
+	
+	if(bDenormalMode)
+	{
+		DenormalGuard guard;
+		for(unsigned int i=0; i<nSamples; i++)
+			out[i] = Process(in[i]);
+	}
+	else
+	{
+		for(unsigned int i=0; i<nSamples; i++)
+			out[i] = Process(in[i]);
+	}
+}
+
+void WDFTree::SetParameterQueue(unsigned int capacity, bool bMultiProducer)
+{
+	delete parameterQueue;
+	parameterQueue = new WDFParameterQueue(capacity, bMultiProducer);
+}
+
+bool WDFTree::PostParameter(const WDFParameter &param)
+{
+	return parameterQueue->Post(param);
+}
+
+bool WDFTree::PostParameter(string id, WDFParameterType type, double value)
+{
+	WDFObject* target = FindObject(id);
+	if(!target)
+		return false;
+	
+	return parameterQueue->Post(WDFParameter(target, type, value));
+}
+
+unsigned int WDFTree::ApplyParameters()
+{
+	WDFParameter param;
+	if(!parameterQueue->Take(param))
+		return 0;
+	
+	// Keep the current states during the change
+	if(engine == WDFEngine::STATE_SPACE)
+		StoreStates();
+	
+	const double Ti = GetInternalSamplingTime();
+	bool bResistance = false, bModel = false;
+	unsigned int nApplied = 0;
+	do
+	{
+		// The change of a constant source is linear in the state-space form
+		const bool bSource = (param.type == WDFParameterType::VOLTAGE && param.target && param.target->type == WDFType::VOLTAGE_SOURCE);
+		const double Vs = bSource ? ((WDFVoltageSource*)param.target)->Vs : 0.0;
+		
+		if(WDFParameterQueue::Apply(param, Ti))
+			bResistance = true;
+		if(bSource && engine == WDFEngine::STATE_SPACE)
+			ChangeStateSpaceSource(param.target, ((WDFVoltageSource*)param.target)->Vs - Vs);
+		if(param.type == WDFParameterType::TUBE_MODEL || param.type == WDFParameterType::PENTODE_MODE)
+			bModel = true;
+		nApplied++;
+	} while(parameterQueue->Take(param));
+	
+	// Update the port resistances once from the root(an R-type adaptor factorizes its matrix here)
+	if(bResistance && wdfRoot)
+		wdfRoot->UpdatePortResistance();
+	
+	// The operating point of the previous model isn't valid
+	if(bModel && wdfRoot && wdfRoot->type == WDFType::R_TYPE_NL)
+		((WDFRTypeAdaptorNL*)wdfRoot)->ResetOperatingPoint();
+	
+	// The state-space form depends on the values of the elements
+	if(bResistance && engine == WDFEngine::STATE_SPACE)
+		CompileStateSpace();
+	
+	// The settled output may be changed
+	bSleeping = false;
+	nSilentSamples = 0;
+	
+	return nApplied;
+}
+
+unsigned int WDFTree::TransferStates(WDFTree* source)
+{
+	if(!source || source == this)
+		return 0;
+	
+	// The wave values of the source are valid only in the wave engine
+	if(source->engine == WDFEngine::STATE_SPACE)
+		source->StoreStates();
+	
+	unsigned int nMatched = 0;
+	for(WDFVector::iterator iter = wdfReactances.begin(); iter != wdfReactances.end(); iter++)
+	{
+		WDFMap::iterator found = source->wdfMap.find((*iter)->label);
+		if(found == source->wdfMap.end() || (*found).second->type != (*iter)->type)
+			continue;
+		
+		WDFPort* from = (*found).second->vecPorts[RFP];
+		WDFPort* to = (*iter)->vecPorts[RFP];
+		if(from->Rp == to->Rp)
+			to->a = from->a;
+		else if((*iter)->type == WDFType::CAPACITOR)
+			to->a = from->GetVoltage();				// b = a: v = a without current
+		else
+			to->a = to->Rp * from->GetCurrent();	// b = -a: i = a / R without voltage
+		
+		nMatched++;
+	}
+	
+	if(engine == WDFEngine::STATE_SPACE)
+	{
+		for(unsigned int i=0; i<stateSpace.GetStateCount() && i<wdfReactances.size(); i++)
+			stateSpace.x[i] = wdfReactances[i]->vecPorts[RFP]->a;
+	}
+	
+	return nMatched;
+}
+
 void WDFTree::AddObject(WDFObject* object)
 {
 	wdfMap[object->label] = object;
+	
+	// Store the elements which have the state
+	if(object->type == WDFType::CAPACITOR || object->type == WDFType::INDUCTOR || object->type == WDFType::OPEN_CIRCUIT)
+		wdfReactances.push_back(object);
+	
+	// SetQuality may run on the audio thread(the governor), so it doesn't allocate
+	if(object->type == WDFType::R_TYPE_NL)
+		wdfLinearizedByQuality.reserve(wdfLinearizedByQuality.capacity() + 1);
 }
 
 WDFObject* WDFTree::FindObject(string id)
 {
-	return wdfMap[id];
+	// operator[] would insert the id, and the control thread would modify the map read by the audio thread
+	WDFMap::iterator found = wdfMap.find(id);
+	return found != wdfMap.end() ? (*found).second : NULL;
+}
+
+WDFTree* WDFTree::CreateInstance()
+{
+	WDFTree* instance = new WDFTree(T, V, F);
+	map<WDFObject*, WDFObject*> objects;
+	map<WDFPort*, WDFPort*> ports;
+	
+	// Copy the objects with their own ports
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		WDFObject* copied = wdfObj->Clone();
+		if(!copied)
+		{
+			delete instance;
+			return NULL;
+		}
+		
+		for(unsigned int i=0; i<copied->vecPorts.size(); i++)
+		{
+			WDFPort* port = new WDFPort(*wdfObj->vecPorts[i]);
+			ports[wdfObj->vecPorts[i]] = port;
+			copied->vecPorts[i] = port;
+		}
+		
+		objects[wdfObj] = copied;
+		instance->wdfMap[(*mapIter).first] = copied;
+	}
+	objects[NULL] = NULL;
+	ports[NULL] = NULL;
+	
+	// Link the copies to each other
+	for(map<WDFObject*, WDFObject*>::iterator iter = objects.begin(); iter != objects.end(); iter++)
+	{
+		WDFObject* copied = (*iter).second;
+		if(!copied)
+			continue;
+		
+		if(!objects.count(copied->parent))
+		{
+			delete instance;
+			return NULL;
+		}
+		copied->parent = objects[copied->parent];
+		
+		for(unsigned int i=0; i<copied->vecChildren.size(); i++)
+		{
+			if(!objects.count(copied->vecChildren[i]))
+			{
+				delete instance;
+				return NULL;
+			}
+			copied->vecChildren[i] = objects[copied->vecChildren[i]];
+		}
+		
+		for(vector<WDFPort*>::iterator portIter = copied->vecPorts.begin(); portIter != copied->vecPorts.end(); portIter++)
+		{
+			if(!ports.count((*portIter)->coupledPort))
+			{
+				delete instance;
+				return NULL;
+			}
+			(*portIter)->coupledPort = ports[(*portIter)->coupledPort];
+			(*portIter)->owner = copied;
+		}
+	}
+	
+	// Set the roles in the same order
+	instance->wdfRoot = objects[wdfRoot];
+	instance->wdfInput = (WDFVoltageSource*)objects[wdfInput];
+	for(WDFVector::iterator iter = wdfOutputs.begin(); iter != wdfOutputs.end(); iter++)
+		instance->wdfOutputs.push_back(objects[*iter]);
+	for(WDFVector::iterator iter = wdfReactances.begin(); iter != wdfReactances.end(); iter++)
+		instance->wdfReactances.push_back(objects[*iter]);
+	
+	// Copy the settings(the elements are already at the internal rate)
+	instance->bSleepEnabled = bSleepEnabled;
+	instance->fSleepThreshold = fSleepThreshold;
+	instance->nSleepHoldSamples = nSleepHoldSamples;
+	instance->bDenormalMode = bDenormalMode;
+	instance->oversampler.SetFactor(oversampler.GetFactor());
+	instance->nOversampling = nOversampling;
+	instance->quality = quality;
+	instance->wdfLinearizedByQuality.reserve(wdfLinearizedByQuality.capacity());
+	for(WDFVector::iterator iter = wdfLinearizedByQuality.begin(); iter != wdfLinearizedByQuality.end(); iter++)
+		instance->wdfLinearizedByQuality.push_back(objects[*iter]);
+	instance->engine = engine;
+	instance->stateSpace = stateSpace;
+	for(WDFVector::iterator iter = wdfConstantSources.begin(); iter != wdfConstantSources.end(); iter++)
+		instance->wdfConstantSources.push_back(objects[*iter]);
+	instance->SetParameterQueue(parameterQueue->GetCapacity(), parameterQueue->IsMultiProducer());
+	
+	return instance;
 }
 
 float WDFTree::GetSamplingTime()
@@ -57,6 +346,149 @@ float WDFTree::GetSamplingTime()
 	return T;
 }
 
+float WDFTree::GetInternalSamplingTime()
+{
+	return T / oversampler.GetFactor();
+}
+
+bool WDFTree::SetOversampling(unsigned int factor)
+{
+	if(factor == 0 || factor > MAX_OVERSAMPLING || (factor & (factor - 1)) != 0)
+		return false;
+	
+	nOversampling = factor;
+	return ApplyOversampling((quality == WDFQuality::REDUCED_RATE && factor > 1) ? factor / 2 : factor);
+}
+
+bool WDFTree::ApplyOversampling(unsigned int factor)
+{
+	if(!oversampler.SetFactor(factor))
+		return false;
+	
+	// Keep the current states during the change
+	if(engine == WDFEngine::STATE_SPACE)
+		StoreStates();
+	
+	// Change the reactive elements to the internal rate
+	const float Ti = GetInternalSamplingTime();
+	for(WDFVector::iterator iter = wdfReactances.begin(); iter != wdfReactances.end(); iter++)
+	{
+		if((*iter)->type == WDFType::CAPACITOR)
+			((WDFCapacitor*)(*iter))->SetSamplingTime(Ti);
+		else if((*iter)->type == WDFType::INDUCTOR)
+			((WDFInductor*)(*iter))->SetSamplingTime(Ti);
+	}
+	
+	// Update the port resistances from the root
+	if(wdfRoot && wdfReactances.size() > 0)
+		wdfRoot->UpdatePortResistance();
+	
+	// The state-space form depends on the sampling time
+	if(engine == WDFEngine::STATE_SPACE)
+		CompileStateSpace();
+	
+	return true;
+}
+
+unsigned int WDFTree::GetOversampling()
+{
+	return oversampler.GetFactor();
+}
+
+void WDFTree::SetQuality(WDFQuality quality)
+{
+	// the limits of the nonlinear solvers
+	int maxIter = 100;
+	double epsilon = 1e-9;
+	if(quality == WDFQuality::RELAXED)
+	{
+		maxIter = 20;
+		epsilon = 1e-6;
+	}
+	else if(quality >= WDFQuality::COARSE)
+	{
+		maxIter = 6;
+		epsilon = 1e-4;
+	}
+	
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		
+		NewtonRaphson* scalarSolver = dynamic_cast<NewtonRaphson*>(wdfObj);
+		if(scalarSolver)
+			scalarSolver->SetSolverLimits(maxIter, epsilon);
+		else if(wdfObj->type == WDFType::R_TYPE_NL)
+			((WDFRTypeAdaptorNL*)wdfObj)->SetSolverLimits(maxIter, epsilon);
+	}
+	
+	// the linearized mode(the roots linearized by the user are not changed)
+	if(quality >= WDFQuality::LINEARIZED && wdfLinearizedByQuality.empty())
+	{
+		for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+		{
+			WDFObject* wdfObj = (*mapIter).second;
+			if(wdfObj->type == WDFType::R_TYPE_NL && !((WDFRTypeAdaptorNL*)wdfObj)->IsLinearizedMode())
+			{
+				((WDFRTypeAdaptorNL*)wdfObj)->SetLinearizedMode(true);
+				wdfLinearizedByQuality.push_back(wdfObj);
+			}
+		}
+	}
+	else if(quality < WDFQuality::LINEARIZED)
+	{
+		for(WDFVector::iterator iter = wdfLinearizedByQuality.begin(); iter != wdfLinearizedByQuality.end(); iter++)
+			((WDFRTypeAdaptorNL*)(*iter))->SetLinearizedMode(false);
+		wdfLinearizedByQuality.clear();
+	}
+	
+	// the rate
+	const bool bReduce = quality == WDFQuality::REDUCED_RATE;
+	if(bReduce != (this->quality == WDFQuality::REDUCED_RATE) && nOversampling > 1)
+		ApplyOversampling(bReduce ? nOversampling / 2 : nOversampling);
+	
+	this->quality = quality;
+}
+
+WDFQuality WDFTree::GetQuality()
+{
+	return quality;
+}
+
+void WDFTree::SetNonlinearSolver(NonlinearSolverType type)
+{
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		if(wdfObj->type == WDFType::R_TYPE_NL)
+			((WDFRTypeAdaptorNL*)wdfObj)->SetSolver(type);
+	}
+}
+
+void WDFTree::SetNonlinearBudget(unsigned int budget, NonlinearFallback fallback)
+{
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		if(wdfObj->type == WDFType::R_TYPE_NL)
+		{
+			NonlinearSolver* solver = ((WDFRTypeAdaptorNL*)wdfObj)->GetSolver();
+			solver->SetIterationBudget(budget);
+			solver->SetFallback(fallback);
+		}
+	}
+}
+
+void WDFTree::SetNonlinearPredictor(NonlinearPredictor predictor, unsigned int order)
+{
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		if(wdfObj->type == WDFType::R_TYPE_NL)
+			((WDFRTypeAdaptorNL*)wdfObj)->SetPredictor(predictor, order);
+	}
+}
+
 float WDFTree::GetInputVoltage()
 {
 	return V;
@@ -93,4 +525,238 @@ void WDFTree::Clear()
 			(*portIter)->b = 0.0;
 		}
 	}
+	
+	// Wake up
+	bSleeping = false;
+	nSilentSamples = 0;
+	fPrevOutput = 0.0;
+	
+	oversampler.Clear();
+	stateSpace.Clear();
+}
+
+void WDFTree::SetSleepMode(bool enable, float threshold, unsigned int holdSamples)
+{
+	bSleepEnabled = enable;
+	fSleepThreshold = threshold;
+	nSleepHoldSamples = holdSamples;
+	
+	bSleeping = false;
+	nSilentSamples = 0;
+}
+
+bool WDFTree::IsSleeping()
+{
+	return bSleeping;
+}
+
+void WDFTree::UpdateSleepState(float Vin, float Vout)
+{
+	// Non-silent input or moving output
+	if(fabs(Vin) > fSleepThreshold || fabs(Vout - fPrevOutput) > fSleepThreshold)
+	{
+		nSilentSamples = 0;
+		return;
+	}
+	
+	// Check the change of the states
+	if(engine == WDFEngine::STATE_SPACE)
+	{
+		if(stateSpace.GetMaxChange() > fSleepThreshold)
+			nSilentSamples = 0;
+		else if(++nSilentSamples >= nSleepHoldSamples)
+			bSleeping = true;
+		return;
+	}
+	
+	// b = z^-1 * a(capacitor), b = z^-1 * (-a)(inductor)
+	for(WDFVector::iterator iter = wdfReactances.begin(); iter != wdfReactances.end(); iter++)
+	{
+		WDFPort* port = (*iter)->vecPorts[RFP];
+		double delta = (*iter)->type == WDFType::INDUCTOR ? port->a + port->b : port->a - port->b;
+		if(fabs(delta) > fSleepThreshold)
+		{
+			nSilentSamples = 0;
+			return;
+		}
+	}
+	
+	// Sleep if the silence lasts
+	if(++nSilentSamples >= nSleepHoldSamples)
+		bSleeping = true;
+}
+
+void WDFTree::SetDenormalMode(bool enable)
+{
+	bDenormalMode = enable;
+}
+
+void WDFTree::SetAntiDenormal(double offset)
+{
+	for(WDFVector::iterator iter = wdfReactances.begin(); iter != wdfReactances.end(); iter++)
+	{
+		if((*iter)->type == WDFType::CAPACITOR)
+			((WDFCapacitor*)(*iter))->antiDenormal = offset;
+		else if((*iter)->type == WDFType::INDUCTOR)
+			((WDFInductor*)(*iter))->antiDenormal = offset;
+	}
+}
+
+bool WDFTree::SetEngine(WDFEngine engine)
+{
+	if(engine == WDFEngine::STATE_SPACE)
+	{
+		if(this->engine == WDFEngine::STATE_SPACE)
+			StoreStates();
+		
+		if(!CompileStateSpace())
+			return false;
+	}
+	else if(this->engine == WDFEngine::STATE_SPACE)
+	{
+		// Continue from the current states
+		StoreStates();
+	}
+	
+	this->engine = engine;
+	
+	return true;
+}
+
+WDFEngine WDFTree::GetEngine()
+{
+	return engine;
+}
+
+bool WDFTree::CompileStateSpace()
+{
+	if(!wdfInput || !wdfRoot)
+		return false;
+	
+	// Only the linear tree has the state-space form
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFType type = (*mapIter).second->type;
+		if(type == WDFType::ROOT_LEAF || type == WDFType::R_TYPE_ROOT_LEAF || type == WDFType::R_TYPE_NL)
+			return false;
+	}
+	
+	// Save the wave values, then they are restored after probing
+	vector<double> waves;
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		for(vector<WDFPort*>::iterator portIter = wdfObj->vecPorts.begin(); portIter != wdfObj->vecPorts.end(); portIter++)
+		{
+			waves.push_back((*portIter)->a);
+			waves.push_back((*portIter)->b);
+		}
+	}
+	const double Vs = wdfInput->Vs;
+	
+	//============================================================
+	// The tree is affine in the states & the input, so each column is probed by a unit impulse.
+	// The response to zero states & zero input is the contribution of the constant sources.
+	//============================================================
+	const unsigned int n = (unsigned int)wdfReactances.size();
+	wdfConstantSources.clear();
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		if(wdfObj->type == WDFType::VOLTAGE_SOURCE && wdfObj != wdfInput)
+			wdfConstantSources.push_back(wdfObj);
+	}
+	const unsigned int m = (unsigned int)wdfConstantSources.size();
+	stateSpace.Resize(n, m);
+	
+	vector<double> x(n, 0.0), xNext(n, 0.0);
+	
+	// constants
+	stateSpace.d = ProbeStateSpace(x, 0.0, xNext);
+	stateSpace.c = xNext;
+	
+	// states
+	for(unsigned int j=0; j<n; j++)
+	{
+		x[j] = 1.0;
+		stateSpace.C[j] = ProbeStateSpace(x, 0.0, xNext) - stateSpace.d;
+		for(unsigned int i=0; i<n; i++)
+			stateSpace.A[i * n + j] = xNext[i] - stateSpace.c[i];
+		x[j] = 0.0;
+	}
+	
+	// input
+	stateSpace.D = ProbeStateSpace(x, 1.0, xNext) - stateSpace.d;
+	for(unsigned int i=0; i<n; i++)
+		stateSpace.B[i] = xNext[i] - stateSpace.c[i];
+	
+	// constant sources, each by a unit step from its value
+	for(unsigned int k=0; k<m; k++)
+	{
+		WDFVoltageSource* source = (WDFVoltageSource*)wdfConstantSources[k];
+		const double value = source->Vs;
+		source->Vs = value + 1.0;
+		stateSpace.F[k] = ProbeStateSpace(x, 0.0, xNext) - stateSpace.d;
+		for(unsigned int i=0; i<n; i++)
+			stateSpace.E[k * n + i] = xNext[i] - stateSpace.c[i];
+		source->Vs = value;
+	}
+	
+	// Restore the wave values
+	unsigned int k = 0;
+	for(WDFMap::iterator mapIter = wdfMap.begin(); mapIter != wdfMap.end(); mapIter++)
+	{
+		WDFObject* wdfObj = (*mapIter).second;
+		for(vector<WDFPort*>::iterator portIter = wdfObj->vecPorts.begin(); portIter != wdfObj->vecPorts.end(); portIter++)
+		{
+			(*portIter)->a = waves[k++];
+			(*portIter)->b = waves[k++];
+		}
+	}
+	wdfInput->Vs = Vs;
+	
+	// Start from the current states
+	for(unsigned int i=0; i<n; i++)
+		stateSpace.x[i] = wdfReactances[i]->vecPorts[RFP]->a;
+	
+	return true;
+}
+
+double WDFTree::ProbeStateSpace(const vector<double> &x, double Vin, vector<double> &xNext)
+{
+	for(unsigned int i=0; i<x.size(); i++)
+		wdfReactances[i]->vecPorts[RFP]->a = x[i];
+	
+	wdfInput->Vs = Vin;
+	wdfRoot->WaveUp();
+	wdfRoot->WaveDown();
+	
+	for(unsigned int i=0; i<xNext.size(); i++)
+		xNext[i] = wdfReactances[i]->vecPorts[RFP]->a;
+	
+	double Vout = 0.0;
+	for(WDFVector::iterator iter = wdfOutputs.begin(); iter != wdfOutputs.end(); iter++)
+		Vout += (*iter)->vecPorts[0]->GetVoltage();
+	
+	return Vout;
+}
+
+void WDFTree::ChangeStateSpaceSource(WDFObject* source, double delta)
+{
+	for(unsigned int k=0; k<wdfConstantSources.size(); k++)
+	{
+		if(wdfConstantSources[k] == source)
+		{
+			stateSpace.ChangeSource(k, delta);
+			return;
+		}
+	}
+	
+	// The input is given to the form every sample
+}
+
+void WDFTree::StoreStates()
+{
+	for(unsigned int i=0; i<stateSpace.GetStateCount() && i<wdfReactances.size(); i++)
+		wdfReactances[i]->vecPorts[RFP]->a = stateSpace.x[i];
 }
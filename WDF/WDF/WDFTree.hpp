@@ -10,6 +10,9 @@
 #define WDFTree_hpp
 
 #include "WDF.hpp"
+#include "Oversampler.hpp"
+#include "StateSpace.hpp"
+#include "WDFParameter.hpp"
 #include <map>
 
 /**
@@ -22,6 +25,27 @@ typedef map<string, WDFObject*>	WDFMap;
  */
 typedef vector<WDFObject*>		WDFVector;
 
+/**
+ The engine which processes the tree
+ */
+enum class WDFEngine
+{
+	WAVE,			// wave propagation through the tree
+	STATE_SPACE		// the state-space form derived from the tree(linear tree only)
+};
+
+/**
+ The quality of the processing. Each level includes the reductions of the previous levels.
+ */
+enum class WDFQuality
+{
+	FULL,			// the default tolerance & iterations of the nonlinear solvers
+	RELAXED,		// looser tolerance, fewer iterations
+	COARSE,			// the minimum tolerance & iterations which still converge in practice
+	LINEARIZED,		// the R-type nonlinear roots use the linearized mode
+	REDUCED_RATE	// the oversampling factor is halved
+};
+
 /**
  A class for building a tree of WDF objects. It takes an (audio) sample as input, process filteration, then creates an output (audio) sample.
  */
@@ -46,6 +70,65 @@ public:
 	 */
 	float Process(float Vin);
 	
+	/**
+	 A process function of the tree for a block of samples
+	 
+	 @param in input voltages
+	 @param out output voltages. It can be same as the input.
+	 @param nSamples the number of samples in the block
+	 */
+	void Process(const float* in, float* out, unsigned int nSamples);
+	
+	/**
+	 Replace the parameter queue. The messages waiting are discarded. Don't call it while the messages are posted or the tree is processed.
+	 
+	 @param capacity the maximum number of messages waiting
+	 @param bMultiProducer true if the messages are posted from more than one thread
+	 */
+	void SetParameterQueue(unsigned int capacity, bool bMultiProducer);
+	
+	/**
+	 Post a parameter message from the control thread. It never blocks, and the change is applied at the start of the next block.
+	 
+	 @param param the message
+	 @return false if the queue is full
+	 */
+	bool PostParameter(const WDFParameter &param);
+	
+	/**
+	 Post a parameter message to the object with id. The object is searched on the calling thread, so don't add objects at the same time.
+	 
+	 @param id the id of the target
+	 @param type the kind of the value
+	 @param value the new value
+	 @return false if the object isn't found or the queue is full
+	 */
+	bool PostParameter(string id, WDFParameterType type, double value);
+	
+	/**
+	 Apply the parameter messages waiting. The block process calls it at the start, so call it only when the sample process is used. The port resistances are updated once for all messages. While the state-space engine is used, a voltage only moves the constant terms, but a resistance, capacitance or inductance derives the form again(it allocates).
+	 
+	 A resistance, capacitance or inductance below an R-type adaptor is NOT real-time safe: the adaptor recomputes and factorizes its scattering matrix on the audio thread. Change such values by compiling a new tree off the audio thread and swapping it by WDFHotSwap. The voltages and the values below the series, parallel and other 3-port adaptors are safe.
+	 
+	 @return the number of messages applied
+	 */
+	unsigned int ApplyParameters();
+	
+	/**
+	 Create an instance of the tree. The instance has its own wave values, and shares the matrices of the R-type adaptors(and MNA) with this tree. The shared matrices are copied only when an instance changes them(e.g. by changing the oversampling factor), so creating an instance is much cheaper than creating a tree again. The settings and the current state are copied. Creating instances from multiple threads is safe while this tree is not processed or changed.
+	 
+	 @return a new tree, or NULL if an object of the tree can't be copied
+	 */
+	WDFTree* CreateInstance();
+	
+	/**
+	 Take over the states of another tree(e.g. the previous version of the circuit). The reactive elements are matched by their ids and types. If the port resistance is same, the stored wave is copied. Otherwise the voltage of a capacitor and the current of an inductor are kept. It doesn't allocate, so it can be called on the audio thread.
+	 
+	 @param source the tree whose states are taken
+	 @return the number of elements matched
+	 */
+	unsigned int TransferStates(WDFTree* source);
+	
 	/**
 	 Add an WDF object to the tree with option
 	 
@@ -57,7 +140,7 @@ public:
 	 Find an WDF object with id
 	 
 	 @param id an id to search
-	 @return an WDF object with which the id is same
+	 @return an WDF object with which the id is same, or NULL if none. The map isn't changed, so it can be called while the audio thread runs.
 	 */
 	WDFObject* FindObject(string id);
 	
@@ -68,6 +151,65 @@ public:
 	 */
 	float GetSamplingTime();
 	
+	/**
+	 Get the sampling time at which the tree is processed. It's the sampling time divided by the oversampling factor.
+	 
+	 @return the internal sampling time
+	 */
+	float GetInternalSamplingTime();
+	
+	/**
+	 Set the oversampling factor. The reactive elements are changed to the internal rate, and the port resistances are updated from the root.
+	 
+	 @param factor the oversampling factor(1, 2, 4 or 8)
+	 @return false if the factor is not supported
+	 */
+	bool SetOversampling(unsigned int factor);
+	
+	/**
+	 Get the oversampling factor
+	 
+	 @return the oversampling factor in use(it's lower than the setting in WDFQuality::REDUCED_RATE)
+	 */
+	unsigned int GetOversampling();
+	
+	/**
+	 Set the quality of the processing. It's cheap except when the oversampling factor is changed(to or from WDFQuality::REDUCED_RATE), which updates the port resistances(an R-type adaptor factorizes its matrix) and isn't real-time safe. WDFQualityGovernor switches the rate by crossfading to a prepared instance instead.
+	 
+	 @param quality the quality level
+	 */
+	void SetQuality(WDFQuality quality);
+	
+	/**
+	 Get the quality of the processing
+	 
+	 @return the quality level
+	 */
+	WDFQuality GetQuality();
+	
+	/**
+	 Select the solver of all nonlinear roots(WDFRTypeAdaptorNL) in the tree
+	 
+	 @param type the type of the solver
+	 */
+	void SetNonlinearSolver(NonlinearSolverType type);
+	
+	/**
+	 Bound the worst case of the solvers of all nonlinear roots in the tree(kept when the solver is changed)
+	 
+	 @param budget the maximum number of iterations per sample(0: unbounded)
+	 @param fallback the solution used when the solve is not converged within the budget
+	 */
+	void SetNonlinearBudget(unsigned int budget, NonlinearFallback fallback);
+	
+	/**
+	 Select the predictor of the initial guess of all nonlinear roots(WDFRTypeAdaptorNL) in the tree
+	 
+	 @param predictor the predictor
+	 @param order the number of the last solutions extrapolated by the polynomial predictor
+	 */
+	void SetNonlinearPredictor(NonlinearPredictor predictor, unsigned int order=2);
+	
 	/**
 	 Get the voltage of the input source(gain)
 	 
@@ -108,7 +250,107 @@ public:
 	 */
 	void Clear();
 	
+	/**
+	 Enable or disable the sleep mode. In the sleep mode, the tree stops the wave propagation while the input is silent and the state of the reactive elements has settled, then outputs the settled value until a non-silent input arrives.
+	 
+	 @param enable true if the sleep mode is used
+	 @param threshold the input level and the change of the states below which the tree is regarded as silent
+	 @param holdSamples the number of silent samples required before sleeping
+	 */
+	void SetSleepMode(bool enable, float threshold=1e-6f, unsigned int holdSamples=64);
+	
+	/**
+	 Check whether the tree is sleeping
+	 
+	 @return true if sleeping
+	 */
+	bool IsSleeping();
+	
+	/**
+	 Enable or disable the denormal-safe mode. In this mode, the flush-to-zero and denormals-are-zero modes are set during the block processing, then restored.
+	 
+	 @param enable true if the denormal-safe mode is used
+	 */
+	void SetDenormalMode(bool enable);
+	
+	/**
+	 Set the anti-denormal offset of the reactive elements. The offset of alternating sign is added to the stored waves, so the decaying waves never become denormal(also with -ffast-math). It's useful when the block processing is not used or FTZ/DAZ is not supported.
+	 
+	 @param offset a tiny offset(e.g. 1e-18). 0 disables it.
+	 */
+	void SetAntiDenormal(double offset);
+	
+	/**
+	 Select the engine. The state-space form is derived by probing the tree once per state, so it's exact for a linear tree. The current state is transferred in both directions. While the state-space engine is used, the wave values of the elements are not updated. Set the engine again after changing the values of the elements.
+	 
+	 @param engine the engine to be used
+	 @return false if the tree has a nonlinear element(the wave engine is kept)
+	 */
+	bool SetEngine(WDFEngine engine);
+	
+	/**
+	 Get the engine
+	 
+	 @return the engine in use
+	 */
+	WDFEngine GetEngine();
+	
 protected:
+	/**
+	 Process a sample at the internal rate
+	 
+	 @param Vin input voltage
+	 @return output voltage
+	 */
+	float ProcessSample(float Vin);
+	
+	/**
+	 Change the rate of the tree
+	 
+	 @param factor the oversampling factor in use
+	 @return false if the factor is not supported
+	 */
+	bool ApplyOversampling(unsigned int factor);
+	
+	/**
+	 Derive the state-space form from the tree. The states are the incident waves of the reactive elements.
+	 
+	 @return false if the tree is not linear
+	 */
+	bool CompileStateSpace();
+	
+	/**
+	 Run the tree once for the given states and input, used to derive the state-space form
+	 
+	 @param x the states
+	 @param Vin input voltage
+	 @param xNext the next states
+	 @return output voltage
+	 */
+	double ProbeStateSpace(const vector<double> &x, double Vin, vector<double> &xNext);
+	
+	/**
+	 Move the constant terms of the state-space form by the change of a voltage source
+	 
+	 @param source the voltage source(nothing is done for the input)
+	 @param delta the change of the voltage
+	 */
+	void ChangeStateSpaceSource(WDFObject* source, double delta);
+	
+	/**
+	 Write the states of the state-space engine to the reactive elements
+	 */
+	void StoreStates();
+	
+	/**
+	 Check the silence of the input and the settlement of the states, then decide whether the tree sleeps
+	 
+	 @param Vin input voltage of the processed sample
+	 @param Vout output voltage of the processed sample
+	 */
+	void UpdateSleepState(float Vin, float Vout);
+	
+
 	/**
 	 the sampling period
 	 */
@@ -143,6 +385,86 @@ protected:
 	 a vector of WDF objects which is set as output
 	 */
 	WDFVector wdfOutputs;
+	
+	/**
+	 a vector of the reactive WDF objects(capacitors, inductors, ...) which store the state of the tree
+	 */
+	WDFVector wdfReactances;
+	
+	/**
+	 true if the sleep mode is enabled
+	 */
+	bool bSleepEnabled;
+	
+	/**
+	 true if the tree is sleeping
+	 */
+	bool bSleeping;
+	
+	/**
+	 the level below which the input and the change of states are regarded as silent
+	 */
+	float fSleepThreshold;
+	
+	/**
+	 the number of silent samples required before sleeping
+	 */
+	unsigned int nSleepHoldSamples;
+	
+	/**
+	 the number of successive silent samples
+	 */
+	unsigned int nSilentSamples;
+	
+	/**
+	 the output value of the previous sample. It's the settled output while sleeping.
+	 */
+	float fPrevOutput;
+	
+	/**
+	 true if FTZ/DAZ is set during the block processing
+	 */
+	bool bDenormalMode;
+	
+	/**
+	 the resampler between the sampling rate and the internal rate
+	 */
+	Oversampler oversampler;
+	
+	/**
+	 the engine in use
+	 */
+	WDFEngine engine;
+	
+	/**
+	 the state-space form of the tree
+	 */
+	StateSpace stateSpace;
+	
+	/**
+	 the voltage sources except the input, in the order of the constant sources of the state-space form
+	 */
+	WDFVector wdfConstantSources;
+	
+	/**
+	 the oversampling factor set by the user
+	 */
+	unsigned int nOversampling;
+	
+	/**
+	 the quality level
+	 */
+	WDFQuality quality;
+	
+	/**
+	 the R-type nonlinear roots whose linearized mode is enabled by the quality level(not by the user)
+	 */
+	WDFVector wdfLinearizedByQuality;
+	
+	/**
+	 the messages from the control threads
+	 */
+	WDFParameterQueue* parameterQueue;
 };
 
 #endif /* WDFTree_hpp */
@@ -18,57 +18,74 @@ WDFRTypeTriode::~WDFRTypeTriode()
 	
 }
 
+WDFObject* WDFRTypeTriode::Clone()
+{
+	return new WDFRTypeTriode(*this);
+}
+
 vec WDFRTypeTriode::Nonlinear(vec V)
+{
+	vec I(2);
+	Nonlinear(V.memptr(), I.memptr());
+	return I;
+}
+
+mat WDFRTypeTriode::DiffNonlinear(vec V)
+{
+	mat J(2,2);
+	DiffNonlinear(V.memptr(), J.memptr(), 2);
+	return J;
+}
+
+void WDFRTypeTriode::Nonlinear(const double* V, double* I)
 {
 	//============================================================
 	// input value: V = [Vgk, Vpk]'
 	// return value: I = [Igk, Ipk]'
 	//============================================================
-	vec I(2);
+	double Ik = G * pow(log(1.0 + exp(C * (V[1] / mu + V[0]))) / C, gamma);
+	double Igk = Gg * pow(log(1.0 + exp(Cg * V[0])) / Cg, e) + Ig0;
 	
-	double Ik = G * pow(log(1.0 + exp(C * (V(1) / mu + V(0)))) / C, gamma);
-	double Igk = Gg * pow(log(1.0 + exp(Cg * V(0))) / Cg, e) + Ig0;
-	
-	I(0) = Igk;
-	I(1) = Ik - Igk;
-	
-	return I;
+	I[0] = Igk;
+	I[1] = Ik - Igk;
 }
 
-mat WDFRTypeTriode::DiffNonlinear(vec V)
+void WDFRTypeTriode::DiffNonlinear(const double* V, double* J, unsigned int ld)
 {
-	mat I(2,2);
-	
-	const double Vgk = V(0);
-	const double Vpk = V(1);
+	double I[2];
+	NonlinearWithJacobian(V, I, J, ld);
+}
+
+void WDFRTypeTriode::NonlinearWithJacobian(const double* V, double* I, double* J, unsigned int ld)
+{
+	const double Vgk = V[0];
+	const double Vpk = V[1];
 	
-	double y_3	= C * (Vpk / mu + Vgk);
-	double dy_3	= C / mu;
-	double y_2	= 1 + exp(y_3);
-	double dy_2	= exp(y_3) * dy_3;
-	double y_1	= log(y_2) / C;
-	double dy_1	= dy_2 / (C * y_2);
-	double dI_k_by_Vpk = gamma * G * pow(y_1, gamma-1) * dy_1;
+	//============================================================
+	// Ik = G * (log(1 + exp(C * (Vpk / mu + Vgk))) / C)^gamma
+	double ek	= exp(C * (Vpk / mu + Vgk));
+	double yk	= log(1.0 + ek) / C;
+	double pk	= pow(yk, gamma - 1);			// shared by Ik & its derivatives
+	double Ik	= G * pk * yk;
+	double dIk	= gamma * G * pk * ek / (1.0 + ek);	// by Vgk(by Vpk: divided by mu)
 	
-	dy_3	= C;
-	y_2		= 1 + exp(y_3);
-	dy_2	= exp(y_3) * dy_3;
-	y_1		= log(y_2) / C;
-	dy_1	= dy_2 / (C * y_2);
-	double dI_k_by_Vgk = gamma * G * pow(y_1, gamma-1) * dy_1;
+	//============================================================
+	// Igk = Gg * (log(1 + exp(Cg * Vgk)) / Cg)^e + Ig0
+	double eg	= exp(Cg * Vgk);
+	double yg	= log(1.0 + eg) / Cg;
+	double pg	= pow(yg, e - 1);
+	double Igk	= Gg * pg * yg + Ig0;
+	double dIg	= e * Gg * pg * eg / (1.0 + eg);
 	
-	y_3		= Cg * Vgk;
-	dy_3	= Cg;
-	y_2		= 1.0 + exp(y_3);
-	dy_2	= exp(y_3) * dy_3;
-	y_1		= log(y_2) / Cg;
-	dy_1	= dy_2 / (Cg * y_2);
-	double dI_g_by_Vgk = e * Gg * pow(y_1, e-1) * dy_1;
+	I[0] = Igk;
+	I[1] = Ik - Igk;
 	
+	double dI_k_by_Vgk = dIk;
+	double dI_k_by_Vpk = dIk / mu;
+	double dI_g_by_Vgk = dIg;
 	double dI_g_by_Vpk = 0.0;
 	
-	I(0,0) = dI_g_by_Vgk;					I(0,1) = dI_g_by_Vpk;
-	I(1,0) = dI_k_by_Vgk - dI_g_by_Vgk;		I(1,1) = dI_k_by_Vpk - dI_g_by_Vpk;
-	
-	return I;
+	// J(r,c) = J[c * ld + r]
+	J[0] = dI_g_by_Vgk;					J[ld] = dI_g_by_Vpk;
+	J[1] = dI_k_by_Vgk - dI_g_by_Vgk;		J[ld + 1] = dI_k_by_Vpk - dI_g_by_Vpk;
 }
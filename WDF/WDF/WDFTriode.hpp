@@ -21,6 +21,7 @@ class WDFRTypeTriode : public WDFRTypeRootLeaf, public DempwolfTriodeParam
 public:
 	WDFRTypeTriode(DempwolfTriodeModel model, string label="R-type triode");
 	~WDFRTypeTriode();
+	virtual WDFObject* Clone();
 	
 	//============================================================
 	// nonlinear function.
@@ -33,6 +34,11 @@ public:
 	// input value: V = [Vgk, Vpk]'
 	// return value: I = [Ig', Ik']'
 	virtual mat DiffNonlinear(vec V);
+	
+	// allocation-free versions(called by the root)
+	virtual void Nonlinear(const double* V, double* I);
+	virtual void DiffNonlinear(const double* V, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* V, double* I, double* J, unsigned int ld);
 };
 
 #endif /* WDFTriode_hpp */
@@ -28,10 +28,14 @@ class WDFRTypeNKTriode : public WDFRTypeRootLeaf, public NormanKoren
 public:
 	WDFRTypeNKTriode(TubeModel model, string label="Triode");
 	~WDFRTypeNKTriode();
+	virtual WDFObject* Clone();
 	
 	// virtual function from WDFRTypeRootLeaf class
 	virtual vec Nonlinear(vec Vc);
 	virtual mat DiffNonlinear(vec Vc);
+	virtual void Nonlinear(const double* Vc, double* Ic);
+	virtual void DiffNonlinear(const double* Vc, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* Vc, double* Ic, double* J, unsigned int ld);
 	
 protected:
 	// Norman Koren Ipk equation
@@ -46,6 +50,7 @@ class WDFRTypeNKPentode : public WDFRTypeRootLeaf, public NormanKoren
 public:
 	WDFRTypeNKPentode(TubeModel model, PentodeMode mode=MODE_PENTODE, string label="Pentode");
 	~WDFRTypeNKPentode();
+	virtual WDFObject* Clone();
 	
 	// set the pentode's mode
 	void SetMode(PentodeMode mode);
@@ -53,12 +58,18 @@ public:
 	// virtual function from WDFRTypeRootLeaf class
 	virtual vec Nonlinear(vec V);
 	virtual mat DiffNonlinear(vec V);
+	virtual void Nonlinear(const double* V, double* I);
+	virtual void DiffNonlinear(const double* V, double* J, unsigned int ld);
+	virtual void NonlinearWithJacobian(const double* V, double* I, double* J, unsigned int ld);
 	
 protected:
+	// the currents I = [Ipk, Ig1k, (Ig2k)]' by V = [Vpk, Vg1k, (Vg2k)]', T is double or Dual(the Jacobian)
+	template<typename T> void Currents(const T* V, T* I) const;
+	
 	// Norman Koren equation
-	double EvaluatePlateCurrent(double Vpk, double Vg1k, double Vg2k=0.0);
-	double EvaluateScreenGridCurrent(double Vg1k, double Vg2k);
-	double EvaluateControlGridCurrent(double Vg1k);
+	template<typename T> T EvaluatePlateCurrent(const T& Vpk, const T& Vg1k, const T& Vg2k) const;
+	template<typename T> T EvaluateScreenGridCurrent(const T& Vg1k, const T& Vg2k) const;
+	template<typename T> T EvaluateControlGridCurrent(const T& Vg1k) const;
 	
 	double g_cf, g_co;
 	PentodeMode mode;	// pentode's mode
@@ -0,0 +1,43 @@
+//
+//  WrightOmega.hpp
+//  WDF
+//
+//  Created by Won Jae Lee on 2018. 3. 29..
+//  Copyright © 2018년 Anti Mouse. All rights reserved.
+//
+
+#ifndef WrightOmega_hpp
+#define WrightOmega_hpp
+
+#include <cmath>
+
+/**
+ Wright omega function, the solution y of y + log(y) = x(y = W(exp(x)) by the Lambert W function).
+ A piecewise approximation(0, cubic, x - log(x)) is corrected by a Newton step on y - exp(x - y) = 0 and another on y + log(y) = x.
+ The relative error is below 1e-3 near x = -3.2 and far smaller elsewhere, without any iteration.
+
+ @param x the argument
+ @return omega(x)
+ */
+inline double WrightOmega(double x)
+{
+	// the initial approximation
+	double y;
+	if(x < -3.341459552768620)
+		y = 0.0;
+	else if(x < 8.0)
+		y = ((-1.314293149877800e-3 * x + 4.775931364975583e-2) * x + 3.631952663804445e-1) * x + 6.313183464296682e-1;
+	else
+		y = x - log(x);
+
+	// y - exp(x - y) = 0, this also makes y = exp(x) in the lower tail
+	y -= (y - exp(x - y)) / (y + 1.0);
+
+	// y + log(y) = x
+	if(y > 0.0)
+		y *= (1.0 - log(y) + x) / (1.0 + y);
+
+	return y;
+}
+
+#endif /* WrightOmega_hpp */